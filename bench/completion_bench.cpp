@@ -0,0 +1,45 @@
+#include "generators.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace command_parser;
+
+// Completion of a partial long name, candidate and subcommand against a
+// rule with max_generated_options options and 1000 subcommands. The
+// trie is built by the first call, before the timed loop.
+
+namespace {
+
+    void add_commands(rule& r) {
+        bench::add_schema(r, bench::max_generated_options);
+        for (int i = 0; i < 1000; i++) {
+            r.add_subcommand("cmd-" + std::to_string(i), "generated", [](rule& sub) {
+                sub.add_option<int>("level", 'l', "level", 1, range<int>(1, 9));
+            });
+        }
+    }
+
+    void BM_Complete(benchmark::State& state, const char* line) {
+        rule r;
+        add_commands(r);
+        benchmark::DoNotOptimize(r.completions(line));
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(r.completions(line));
+        }
+    }
+
+}
+
+BENCHMARK_CAPTURE(BM_Complete, long_name, "tool --opt-1");
+BENCHMARK_CAPTURE(BM_Complete, candidate, "tool -v --mode=");
+BENCHMARK_CAPTURE(BM_Complete, subcommand, "tool -j 4 cmd-51");
+BENCHMARK_CAPTURE(BM_Complete, in_subcommand, "tool cmd-517 --l");
+
+static void BM_CompletionTrieBuild(benchmark::State& state) {
+    for (auto _ : state) {
+        rule r;
+        add_commands(r);
+        benchmark::DoNotOptimize(r.completions("tool --opt-1"));
+    }
+}
+BENCHMARK(BM_CompletionTrieBuild)->Unit(benchmark::kMicrosecond);
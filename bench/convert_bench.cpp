@@ -0,0 +1,98 @@
+#include "generators.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace command_parser;
+
+namespace {
+
+    // 1024 valid inputs of T.
+    template <class T>
+    const std::vector<std::string>& inputs() {
+        static const std::vector<std::string> values = [] {
+            bench::generator g(7);
+            std::vector<std::string> v;
+            for (int i = 0; i < 1024; i++) {
+                if constexpr (std::is_same<T, bool>::value) {
+                    static const char* const words[] = {"true", "false", "1", "0"};
+                    v.push_back(words[g.below(4)]);
+                } else if constexpr (std::is_floating_point<T>::value) {
+                    v.push_back(std::to_string(g.between(-100000, 100000)) + "." + std::to_string(g.below(1000000)));
+                } else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value) {
+                    v.push_back(std::to_string(g.between(-1000000, 1000000)));
+                } else if constexpr (std::is_integral<T>::value) {
+                    v.push_back(std::to_string(g.below(2000000)));
+                } else {
+                    v.push_back(g.word(4, 24));
+                }
+            }
+            return v;
+        }();
+        return values;
+    }
+
+    template <class T>
+    void BM_TryConvert(benchmark::State& state) {
+        const std::vector<std::string>& in = inputs<T>();
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(try_convert<T>(in[i++ & 1023]));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    template <class T>
+    void BM_Convert(benchmark::State& state) {
+        const std::vector<std::string>& in = inputs<T>();
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(convert<T>(in[i++ & 1023]));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    // The std::sto* conversions convert<T> used before.
+    void BM_Stoi(benchmark::State& state) {
+        const std::vector<std::string>& in = inputs<int>();
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(std::stoi(in[i++ & 1023]));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    void BM_Stod(benchmark::State& state) {
+        const std::vector<std::string>& in = inputs<double>();
+        size_t i = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(std::stod(in[i++ & 1023]));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+}
+
+BENCHMARK_TEMPLATE(BM_TryConvert, int);
+BENCHMARK_TEMPLATE(BM_TryConvert, long);
+BENCHMARK_TEMPLATE(BM_TryConvert, long long);
+BENCHMARK_TEMPLATE(BM_TryConvert, unsigned);
+BENCHMARK_TEMPLATE(BM_TryConvert, unsigned long long);
+BENCHMARK_TEMPLATE(BM_TryConvert, float);
+BENCHMARK_TEMPLATE(BM_TryConvert, double);
+BENCHMARK_TEMPLATE(BM_TryConvert, long double);
+BENCHMARK_TEMPLATE(BM_TryConvert, bool);
+BENCHMARK_TEMPLATE(BM_TryConvert, std::string_view);
+
+BENCHMARK_TEMPLATE(BM_Convert, int);
+BENCHMARK_TEMPLATE(BM_Convert, long);
+BENCHMARK_TEMPLATE(BM_Convert, long long);
+BENCHMARK_TEMPLATE(BM_Convert, unsigned);
+BENCHMARK_TEMPLATE(BM_Convert, unsigned long long);
+BENCHMARK_TEMPLATE(BM_Convert, float);
+BENCHMARK_TEMPLATE(BM_Convert, double);
+BENCHMARK_TEMPLATE(BM_Convert, long double);
+BENCHMARK_TEMPLATE(BM_Convert, bool);
+BENCHMARK_TEMPLATE(BM_Convert, std::string);
+
+BENCHMARK(BM_Stoi);
+BENCHMARK(BM_Stod);
@@ -0,0 +1,147 @@
+#ifndef CMDPSR_BENCH_GENERATORS_HPP
+#define CMDPSR_BENCH_GENERATORS_HPP
+
+#include "command_line.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Inputs of the benchmarks. Only the raw output of std::mt19937 is used,
+// whose sequence the standard fixes, so a seed gives the same inputs on
+// every platform and every run.
+namespace bench {
+
+    class generator {
+    public:
+        explicit generator(uint32_t seed) : rng_(seed) { }
+
+        uint32_t below(uint32_t n) {
+            return rng_() % n;
+        }
+        int between(int min, int max) {
+            return min + (int)below((uint32_t)(max - min + 1));
+        }
+        // [a-z]{min,max}
+        std::string word(size_t min, size_t max) {
+            std::string s(min + below((uint32_t)(max - min + 1)), 'a');
+            for (char& c : s) {
+                c = (char)('a' + below(26));
+            }
+            return s;
+        }
+
+    private:
+        std::mt19937 rng_;
+    };
+
+    // argv that owns its elements, argv[0] is "bench".
+    class argv_list {
+    public:
+        argv_list() {
+            push("bench");
+        }
+        argv_list(const argv_list&) = delete;
+
+        void push(std::string arg) {
+            words_.push_back(std::move(arg));
+            argv_.push_back(words_.back().c_str());
+        }
+        int argc() const {
+            return (int)argv_.size();
+        }
+        const char** data() {
+            return argv_.data();
+        }
+        const std::deque<std::string>& words() const {
+            return words_;
+        }
+
+    private:
+        std::deque<std::string> words_;
+        std::vector<const char*> argv_;
+    };
+
+    // Options "opt-0" ... of add_schema besides the fixed ones below.
+    // Short names have to be unique, the generated ones take the bytes
+    // from 128 up.
+    constexpr int generated_options = 24;
+    constexpr int max_generated_options = 128;
+
+    // The rule the parse benchmarks run against: flags, typed options with
+    // range, candidate and regex validators, a list option, and a
+    // variadic parameter that takes every positional argument.
+    inline void add_schema(command_parser::rule& r, int options = generated_options) {
+        using namespace command_parser;
+        r.add_option("verbose", 'v', "verbose output");
+        r.add_option("quiet", 'q', "no output");
+        r.add_option<int>("jobs", 'j', "number of jobs", 1, range<int>(1, 64));
+        r.add_option<double>("ratio", 'x', "ratio", 0.5);
+        r.add_option<std::string>("mode", 'm', "mode", "fast", oneof<std::string>("fast", "safe", "debug"));
+        r.add_option<std::string>("host", 'H', "host", "0.0.0.0", regex("\\d{1,3}(\\.\\d{1,3}){3}"));
+        r.add_list_option<std::string>("define", 'D', "definitions");
+        for (int i = 0; i < options; i++) {
+            r.add_option<std::string>("opt-" + std::to_string(i), (char)(128 + i), "generated option", "");
+        }
+        r.add_parameter("input", "input file");
+        r.add_variadic_parameter("files", "more files");
+    }
+
+    // tokens elements for add_schema(): long options with a value after
+    // '=', short options with attached and separate values, flag
+    // clusters, list elements and positional arguments. The first element
+    // is always positional.
+    inline void make_argv(argv_list& out, size_t tokens, uint32_t seed = 1, int options = generated_options) {
+        generator g(seed);
+        static const char* const modes[] = {"fast", "safe", "debug"};
+        for (size_t n = 0; n < tokens; n++) {
+            uint32_t kind = n == 0 ? 7 : g.below(8);
+            if (kind == 1 && n + 1 == tokens) {
+                kind = 0;
+            }
+            switch (kind) {
+            case 0:
+                out.push("--jobs=" + std::to_string(g.between(1, 64)));
+                break;
+            case 1:
+                out.push("-j");
+                out.push(std::to_string(g.between(1, 64)));
+                n++;
+                break;
+            case 2:
+                out.push(g.below(2) ? "-vq" : "-v");
+                break;
+            case 3:
+                out.push(std::string("--mode=") + modes[g.below(3)]);
+                break;
+            case 4:
+                out.push("-D" + g.word(3, 8) + "=" + g.word(1, 6));
+                break;
+            case 5:
+                out.push("--opt-" + std::to_string(g.below((uint32_t)options)) + "=" + g.word(4, 12));
+                break;
+            default:
+                out.push("src/" + g.word(4, 12) + "/" + g.word(4, 12) + ".cpp");
+                break;
+            }
+        }
+    }
+
+    // make_argv(tokens) built once per process, the 1M element argv takes
+    // longer to build than to parse.
+    inline argv_list& cached_argv(size_t tokens) {
+        static std::map<size_t, argv_list> cache;
+        auto it = cache.find(tokens);
+        if (it == cache.end()) {
+            it = cache.try_emplace(tokens).first;
+            make_argv(it->second, tokens);
+        }
+        return it->second;
+    }
+
+}
+
+#endif  // CMDPSR_BENCH_GENERATORS_HPP
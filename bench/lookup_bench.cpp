@@ -0,0 +1,50 @@
+#include "generators.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace command_parser;
+
+namespace {
+
+    // OptionsInfo of n options with generated long names, and 1024 names
+    // to look up of which about one in eight is unknown.
+    struct Lookup {
+        explicit Lookup(int n) {
+            bench::generator g(11);
+            std::vector<std::string> names;
+            for (int i = 0; i < n; i++) {
+                names.push_back(g.word(3, 10) + "-" + std::to_string(i));
+                info.add(detail::Option(std::pmr::get_default_resource(), names.back(), (char)(128 + i), "generated"));
+            }
+            for (int i = 0; i < 1024; i++) {
+                queries.push_back(g.below(8) == 0 ? g.word(3, 10) : names[g.below((uint32_t)n)]);
+                shorts.push_back(g.below(8) == 0 ? 'a' : (char)(128 + g.below((uint32_t)n)));
+            }
+        }
+
+        detail::OptionsInfo info;
+        std::vector<std::string> queries;
+        std::vector<char> shorts;
+    };
+
+}
+
+static void BM_LongNameLookup(benchmark::State& state) {
+    Lookup l((int)state.range(0));
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(l.info.find(std::string_view(l.queries[i++ & 1023])));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LongNameLookup)->Arg(8)->Arg(32)->Arg(128);
+
+static void BM_ShortNameLookup(benchmark::State& state) {
+    Lookup l((int)state.range(0));
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(l.info.find(l.shorts[i++ & 1023]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ShortNameLookup)->Arg(8)->Arg(32)->Arg(128);
@@ -0,0 +1,111 @@
+#include "generators.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
+
+using namespace command_parser;
+
+static void BM_Parse(benchmark::State& state) {
+    rule r;
+    bench::add_schema(r);
+    r.set_argument_storage(state.range(1) ? argument_storage::view : argument_storage::owned);
+    bench::argv_list& args = bench::cached_argv((size_t)state.range(0));
+    state.SetLabel(state.range(1) ? "view" : "owned");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r.parse_args(args.argc(), args.data()));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Parse)->ArgsProduct({{10, 1000, 1000000}, {0, 1}})->Unit(benchmark::kMicrosecond);
+
+// Results allocated from an arena that is reset after each parse.
+static void BM_ParseArena(benchmark::State& state) {
+    rule r;
+    bench::add_schema(r);
+    r.set_argument_storage(argument_storage::view);
+    bench::argv_list& args = bench::cached_argv((size_t)state.range(0));
+    std::vector<std::byte> buffer(1 << 22);
+    for (auto _ : state) {
+        std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+        benchmark::DoNotOptimize(r.parse_args(args.argc(), args.data(), &arena));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParseArena)->Arg(10)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+static void BM_TryParseRejected(benchmark::State& state) {
+    rule r;
+    bench::add_schema(r);
+    const char* argv[] = {"bench", "--jobs=500", "input"};
+    parse_error error;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r.try_parse(3, argv, error));
+    }
+}
+BENCHMARK(BM_TryParseRejected);
+
+// One "--level=1,2,..." of n elements, with and without a reserve hint.
+static void BM_ListOption(benchmark::State& state) {
+    rule r;
+    r.add_list_option<int>("level", 'l', "levels", ',', range<int>(1, 9));
+    if (state.range(1)) {
+        r.reserve_option("level", (size_t)state.range(0));
+    }
+    bench::generator g(5);
+    std::string arg = "--level=";
+    for (int i = 0; i < state.range(0); i++) {
+        arg += std::to_string(g.between(1, 9)) + ",";
+    }
+    arg.pop_back();
+    const char* argv[] = {"bench", arg.c_str()};
+    state.SetLabel(state.range(1) ? "reserved" : "");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r.parse_args(2, argv));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ListOption)->ArgsProduct({{1000, 100000}, {0, 1}});
+
+static void BM_ResponseFile(benchmark::State& state) {
+    std::string path = (std::filesystem::temp_directory_path() /
+                        ("cmdpsr_bench_" + std::to_string(state.range(0)) + ".rsp")).string();
+    {
+        bench::generator g(9);
+        std::ofstream out(path);
+        for (int i = 0; i < state.range(0); i++) {
+            std::string word = "obj/" + g.word(4, 12) + ".o";
+            out << (g.below(8) == 0 ? "'quoted " + word + "'" : word) << "\n";
+        }
+    }
+    std::string at = "@" + path;
+    const char* argv[] = {"bench", at.c_str()};
+    rule r;
+    r.set_response_files(true);
+    r.set_argument_storage(state.range(1) ? argument_storage::view : argument_storage::owned);
+    r.add_variadic_parameter("files", "files");
+    state.SetLabel(state.range(1) ? "view" : "owned");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r.parse_args(2, argv));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_ResponseFile)->ArgsProduct({{1000, 100000}, {0, 1}})->Unit(benchmark::kMicrosecond);
+
+static void BM_ParseBatch(benchmark::State& state) {
+    rule r;
+    bench::add_schema(r);
+    bench::generator g(13);
+    std::string text;
+    for (int i = 0; i < state.range(0); i++) {
+        text += "--jobs=" + std::to_string(g.between(1, 64)) + " -v 'src/" + g.word(4, 12) + ".cpp' --mode=safe\n";
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r.parse_batch(text, (unsigned)state.range(1)));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParseBatch)->ArgsProduct({{10000}, {1, 4}})->Unit(benchmark::kMillisecond)->UseRealTime();
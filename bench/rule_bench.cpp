@@ -0,0 +1,64 @@
+#include "generators.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <memory_resource>
+
+using namespace command_parser;
+
+static void BM_RuleConstruction(benchmark::State& state) {
+    for (auto _ : state) {
+        rule r;
+        bench::add_schema(r, (int)state.range(0));
+        benchmark::DoNotOptimize(r);
+    }
+    state.SetItemsProcessed(state.iterations() * (state.range(0) + 9));
+}
+BENCHMARK(BM_RuleConstruction)->Arg(8)->Arg(32)->Arg(bench::max_generated_options);
+
+static void BM_RuleConstructionArena(benchmark::State& state) {
+    std::vector<std::byte> buffer(1 << 20);
+    for (auto _ : state) {
+        std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+        rule r(&arena);
+        bench::add_schema(r, (int)state.range(0));
+        benchmark::DoNotOptimize(r);
+    }
+    state.SetItemsProcessed(state.iterations() * (state.range(0) + 9));
+}
+BENCHMARK(BM_RuleConstructionArena)->Arg(8)->Arg(32)->Arg(bench::max_generated_options);
+
+static void BM_AddSubcommands(benchmark::State& state) {
+    std::vector<std::string> names;
+    for (int i = 0; i < state.range(0); i++) {
+        names.push_back("cmd-" + std::to_string(i));
+    }
+    for (auto _ : state) {
+        rule r;
+        for (const std::string& name : names) {
+            r.add_subcommand(name, "generated", [](rule& sub) {
+                sub.add_option<int>("level", 'l', "level", 1, range<int>(1, 9));
+                sub.add_parameter("table", "table");
+            });
+        }
+        benchmark::DoNotOptimize(r);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_AddSubcommands)->Arg(10)->Arg(1000);
+
+static void BM_SubcommandParse(benchmark::State& state) {
+    rule r;
+    r.add_option("verbose", 'v', "verbose output");
+    for (int i = 0; i < 1000; i++) {
+        r.add_subcommand("cmd-" + std::to_string(i), "generated", [](rule& sub) {
+            sub.add_option<int>("level", 'l', "level", 1, range<int>(1, 9));
+            sub.add_parameter("table", "table");
+        });
+    }
+    const char* argv[] = {"tool", "-v", "cmd-517", "-l", "3", "users"};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r.parse_args(6, argv));
+    }
+}
+BENCHMARK(BM_SubcommandParse);
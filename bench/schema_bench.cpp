@@ -0,0 +1,86 @@
+#include "generators.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <memory_resource>
+
+using namespace command_parser;
+
+// A rule read from a saved schema image against BM_RuleConstruction and
+// BM_AddSubcommands, which build the same rules with add_option and
+// add_subcommand. With few options both spend most of their time
+// compiling the regex of "--host", which is compiled again on load.
+
+namespace {
+
+    std::string image_of(int options, int commands = 0) {
+        rule r;
+        if (options != 0) {
+            bench::add_schema(r, options);
+        }
+        for (int i = 0; i < commands; i++) {
+            r.add_subcommand("cmd-" + std::to_string(i), "generated", [](rule& sub) {
+                sub.add_option<int>("level", 'l', "level", 1, range<int>(1, 9));
+                sub.add_parameter("table", "table");
+            });
+        }
+        return r.save_schema();
+    }
+
+}
+
+static void BM_SchemaLoad(benchmark::State& state) {
+    std::string image = image_of((int)state.range(0));
+    schema s(image);
+    for (auto _ : state) {
+        rule r(s);
+        benchmark::DoNotOptimize(r);
+    }
+    state.SetItemsProcessed(state.iterations() * (state.range(0) + 9));
+}
+BENCHMARK(BM_SchemaLoad)->Arg(8)->Arg(32)->Arg(bench::max_generated_options);
+
+static void BM_SchemaLoadArena(benchmark::State& state) {
+    std::string image = image_of((int)state.range(0));
+    schema s(image);
+    std::vector<std::byte> buffer(1 << 20);
+    for (auto _ : state) {
+        std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+        rule r(s, &arena);
+        benchmark::DoNotOptimize(r);
+    }
+    state.SetItemsProcessed(state.iterations() * (state.range(0) + 9));
+}
+BENCHMARK(BM_SchemaLoadArena)->Arg(8)->Arg(32)->Arg(bench::max_generated_options);
+
+static void BM_SchemaLoadSubcommands(benchmark::State& state) {
+    std::string image = image_of(0, (int)state.range(0));
+    schema s(image);
+    for (auto _ : state) {
+        rule r(s);
+        benchmark::DoNotOptimize(r);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SchemaLoadSubcommands)->Arg(10)->Arg(1000);
+
+static void BM_SchemaSave(benchmark::State& state) {
+    rule r;
+    bench::add_schema(r, (int)state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r.save_schema());
+    }
+}
+BENCHMARK(BM_SchemaSave)->Arg(bench::max_generated_options);
+
+static void BM_SchemaParse(benchmark::State& state) {
+    std::string image = image_of(bench::generated_options, 1000);
+    rule r{schema(image)};
+    r.set_argument_storage(argument_storage::view);
+    bench::argv_list& args = bench::cached_argv((size_t)state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r.parse_args(args.argc(), args.data()));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SchemaParse)->Arg(10)->Arg(1000)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,24 @@
+#include "generators.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace command_parser;
+
+// Arg 0 parses without an observer, otherwise one parse in that many is
+// measured. Compare with BM_Parse of cmdpsr_bench for the cost of having
+// the instrumentation compiled in at all.
+static void BM_ParseStats(benchmark::State& state) {
+    rule r;
+    bench::add_schema(r);
+    uint64_t total = 0;
+    if (state.range(1) != 0) {
+        r.set_stats_observer([&total](const parse_stats& s) { total += s.total_ns; }, (unsigned)state.range(1));
+    }
+    bench::argv_list& args = bench::cached_argv((size_t)state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r.parse_args(args.argc(), args.data()));
+    }
+    benchmark::DoNotOptimize(total);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParseStats)->ArgsProduct({{10, 1000}, {0, 1, 64}})->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,61 @@
+#include "generators.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace command_parser;
+
+// "Did you mean" lookups after a rejected parse, against n oneof
+// candidates or n subcommands of generated names.
+
+static void BM_EditDistance(benchmark::State& state) {
+    bench::generator g(17);
+    std::vector<std::string> names;
+    for (int i = 0; i < 1024; i++) {
+        names.push_back(g.word(4, 16));
+    }
+    detail::EditDistance distance(names[0]);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(distance(names[i++ & 1023], 64));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EditDistance);
+
+static void BM_SuggestCandidate(benchmark::State& state) {
+    bench::generator g(19);
+    oneof<std::string> values;
+    for (int i = 0; i < state.range(0); i++) {
+        values.candidates().push_back(g.word(4, 12) + "-" + std::to_string(i));
+    }
+    rule r;
+    r.add_option<std::string>("value", 'V', "value", values.candidates()[0], values);
+    std::string typo = "--value=" + values.candidates()[values.candidates().size() / 2];
+    typo.back() = '#';
+    const char* argv[] = {"bench", typo.c_str()};
+    parse_error error;
+    for (auto _ : state) {
+        r.try_parse(2, argv, error);
+        benchmark::DoNotOptimize(error.suggestions());
+    }
+}
+BENCHMARK(BM_SuggestCandidate)->Arg(100)->Arg(10000)->Arg(100000);
+
+static void BM_SuggestCommand(benchmark::State& state) {
+    bench::generator g(23);
+    rule r;
+    std::vector<std::string> names;
+    for (int i = 0; i < state.range(0); i++) {
+        names.push_back(g.word(4, 12) + "-" + std::to_string(i));
+        r.add_subcommand(names.back(), "generated", [](rule&) { });
+    }
+    std::string typo = names[names.size() / 2];
+    typo[0] = '#';
+    const char* argv[] = {"bench", typo.c_str()};
+    parse_error error;
+    for (auto _ : state) {
+        r.try_parse(2, argv, error);
+        benchmark::DoNotOptimize(error.suggestions());
+    }
+}
+BENCHMARK(BM_SuggestCommand)->Arg(100)->Arg(10000);
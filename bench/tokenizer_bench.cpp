@@ -0,0 +1,33 @@
+#include "generators.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <regex>
+
+using namespace command_parser;
+
+// classify() against the three std::regex patterns it replaced.
+
+static void BM_Classify(benchmark::State& state) {
+    const std::deque<std::string>& words = bench::cached_argv(1000).words();
+    for (auto _ : state) {
+        for (const std::string& w : words) {
+            benchmark::DoNotOptimize(detail::classify(w));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * words.size());
+}
+BENCHMARK(BM_Classify);
+
+static void BM_ClassifyRegex(benchmark::State& state) {
+    const std::deque<std::string>& words = bench::cached_argv(1000).words();
+    const std::regex lvtype("--[\\w|-]*=.*"), ltype("--[\\w]*"), stype("-[\\w]");
+    for (auto _ : state) {
+        for (const std::string& w : words) {
+            int type = std::regex_match(w, lvtype) ? 2 : std::regex_match(w, ltype) ? 1 : std::regex_match(w, stype) ? 3 : -1;
+            benchmark::DoNotOptimize(type);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * words.size());
+}
+BENCHMARK(BM_ClassifyRegex);
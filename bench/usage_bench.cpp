@@ -0,0 +1,30 @@
+#include "generators.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace command_parser;
+
+// Usage text of the cached rendering, and rendered anew each time by
+// switching between two program names.
+
+static void BM_UsageCached(benchmark::State& state) {
+    rule r;
+    bench::add_schema(r, (int)state.range(0));
+    r.set_help_width(100);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r.usage_text("bench"));
+    }
+}
+BENCHMARK(BM_UsageCached)->Arg(8)->Arg(bench::max_generated_options);
+
+static void BM_UsageRender(benchmark::State& state) {
+    rule r;
+    bench::add_schema(r, (int)state.range(0));
+    r.set_help_width(100);
+    const char* programs[] = {"bench", "other"};
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r.usage_text(programs[i++ & 1]));
+    }
+}
+BENCHMARK(BM_UsageRender)->Arg(8)->Arg(bench::max_generated_options);
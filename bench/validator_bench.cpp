@@ -0,0 +1,88 @@
+#include "generators.hpp"
+
+#include <benchmark/benchmark.h>
+
+using namespace command_parser;
+
+// 64 values of one option per parse, so the difference to "none" is the
+// cost of the validator.
+
+namespace {
+
+    enum kind {
+        none,
+        in_range,
+        candidates,
+        pattern,
+        user,
+    };
+
+    struct even_length {
+        bool operator()(const std::string& param) const {
+            return param.size() % 2 == 0;
+        }
+    };
+
+    void add_value(rule& r, kind k) {
+        switch (k) {
+        case none:
+            r.add_option<std::string>("value", 'V', "value", "");
+            break;
+        case in_range:
+            r.add_option<int>("value", 'V', "value", 1, range<int>(1, 1000));
+            break;
+        case candidates:
+            r.add_option<std::string>("value", 'V', "value", "alpha",
+                oneof<std::string>("alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel"));
+            break;
+        case pattern:
+            r.add_option<std::string>("value", 'V', "value", "0.0.0.0", regex("\\d{1,3}(\\.\\d{1,3}){3}"));
+            break;
+        case user:
+            r.add_option<std::string>("value", 'V', "value", "ab", even_length());
+            break;
+        }
+    }
+
+    std::string value_of(bench::generator& g, kind k) {
+        static const char* const words[] = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel"};
+        switch (k) {
+        case in_range:
+            return std::to_string(g.between(1, 1000));
+        case candidates:
+            return words[g.below(8)];
+        case pattern:
+            return std::to_string(g.below(256)) + "." + std::to_string(g.below(256)) + "." +
+                   std::to_string(g.below(256)) + "." + std::to_string(g.below(256));
+        case user:
+            return g.word(2, 2) + g.word(0, 3) + g.word(0, 3);
+        default:
+            return g.word(4, 12);
+        }
+    }
+
+    void BM_Validator(benchmark::State& state) {
+        kind k = (kind)state.range(0);
+        rule r;
+        r.set_validation(state.range(1) ? validation::lazy : validation::eager);
+        add_value(r, k);
+        bench::argv_list args;
+        bench::generator g(3);
+        for (int i = 0; i < 64; i++) {
+            std::string value;
+            do {
+                value = value_of(g, k);
+            } while (k == user && value.size() % 2 != 0);
+            args.push("--value=" + value);
+        }
+        static const char* const names[] = {"none", "range", "oneof", "regex", "user"};
+        state.SetLabel(std::string(names[k]) + (state.range(1) ? " lazy" : ""));
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(r.parse_args(args.argc(), args.data()));
+        }
+        state.SetItemsProcessed(state.iterations() * 64);
+    }
+
+}
+
+BENCHMARK(BM_Validator)->ArgsProduct({{none, in_range, candidates, pattern, user}, {0, 1}});
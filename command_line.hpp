@@ -1,6 +1,11 @@
+#ifndef COMMAND_PARSER_COMMAND_LINE_HPP
+#define COMMAND_PARSER_COMMAND_LINE_HPP
+
 
 #include <map>
+#include <array>
 #include <set>
+#include <deque>
 #include <vector>
 #include <string>
 #include <stdexcept>
@@ -8,65 +13,230 @@
 #include <iostream>
 #include <iomanip>
 #include <memory>
+#include <memory_resource>
+#include <new>
+#include <cstddef>
 #include <functional>
-#include <regex>
+#include <string_view>
 #include <stdexcept>
 #include <sstream>
 #include <type_traits>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cctype>
+#include <tuple>
+#include <optional>
+#include <iterator>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <shared_mutex>
+#include <mutex>
+#include <fstream>
+#include <regex>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#define COMMAND_PARSER_MMAP 1
+#else
+#define COMMAND_PARSER_MMAP 0
+#endif
+#include <utility>
+
+// The conversion layer and static_rule do not use exceptions, rule does.
+// With -fno-exceptions only the former are available.
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+#define COMMAND_PARSER_EXCEPTIONS 1
+#else
+#define COMMAND_PARSER_EXCEPTIONS 0
+#endif
+
+// Define COMMAND_PARSER_STATS as 1 for rule::set_stats_observer, otherwise
+// the instrumentation is compiled out.
+#ifndef COMMAND_PARSER_STATS
+#define COMMAND_PARSER_STATS 0
+#endif
 
 namespace command_parser {
 
+    // Result of try_convert. ec tells why the conversion failed.
+    enum class convert_errc {
+        ok = 0,
+        invalid_argument,
+        out_of_range,
+    };
+
     template <class T>
-    T convert(const std::string& param);
+    struct convert_result {
+        T value {};
+        convert_errc ec = convert_errc::ok;
 
-    template <>
-    int convert(const std::string& param) {
-        size_t* idx = nullptr;
-        int val = 0;
-        try {
-            val = std::stoi(param, idx);
-        } catch (...) {
-            throw std::runtime_error(param + " is not integer");
+        explicit operator bool() const noexcept {
+            return ec == convert_errc::ok;
         }
-        if (idx != nullptr) { 
-            throw std::runtime_error(param + " is not integer");
+    };
+
+    namespace detail {
+        template <class T>
+        struct dependent_false : std::false_type {};
+    };
+
+    // Locale independent conversion based on std::from_chars.
+    // The whole input has to be consumed, a leading '+' is accepted for
+    // numbers. Supports every integral type, float, double, long double,
+    // bool ("true", "false", "1", "0") and std::string_view.
+    // Never throws and never allocates.
+    template <class T>
+    convert_result<T> try_convert(std::string_view param) noexcept {
+        convert_result<T> res;
+        if constexpr (std::is_same<T, bool>::value) {
+            if (param == "true" || param == "1") {
+                res.value = true;
+            } else if (param == "false" || param == "0") {
+                res.value = false;
+            } else {
+                res.ec = convert_errc::invalid_argument;
+            }
+        } else if constexpr (std::is_integral<T>::value || std::is_floating_point<T>::value) {
+            const char* first = param.data();
+            const char* last = first + param.size();
+            if (last - first > 1 && *first == '+' && first[1] != '-' && first[1] != '+') {
+                first++;
+            }
+            auto r = std::from_chars(first, last, res.value);
+            if (r.ec == std::errc::result_out_of_range) {
+                res.ec = convert_errc::out_of_range;
+            } else if (r.ec != std::errc() || r.ptr != last || first == last) {
+                res.ec = convert_errc::invalid_argument;
+            }
+        } else if constexpr (std::is_same<T, std::string_view>::value) {
+            res.value = param;
+        } else {
+            static_assert(detail::dependent_false<T>::value, "try_convert does not support this type");
         }
-        return val;
+        return res;
     }
 
-    template <>
-    long convert(const std::string& param) {
-        size_t* idx = nullptr;
-        long val = 0;
-        try {
-            val = std::stol(param, idx);
-        } catch (...) {
-            throw std::runtime_error(param + " is not integer");
+    namespace detail {
+
+        template <class T>
+        std::string to_str(T val) {
+            return std::to_string(val);
+        }
+
+        template <>
+        inline std::string to_str(std::string val) {
+            return val;
         }
-        if (idx != nullptr) { 
-            throw std::runtime_error(param + " is not integer");
+
+        // Text appended to the input when convert<T> fails.
+        template <class T>
+        const char* convert_error() {
+            if constexpr (std::is_same<T, bool>::value) {
+                return " is not boolean";
+            } else if constexpr (std::is_floating_point<T>::value) {
+                return " is not floating point number";
+            } else {
+                return " is not integer";
+            }
         }
-        return val;
-    }
 
-    template <>
-    double convert(const std::string& param) {
-        size_t* idx = nullptr;
-        double val = 0.0;
-        try {
-            val = std::stod(param, idx);
-        } catch (...) {
-            throw std::runtime_error(param + " is not floating point number");
+        enum class OptionType {
+            NOT_OP = -1,
+            LONG = 1,
+            LONG_WITH_VAL = 2,
+            SHORT = 3,
+        };
+
+        // One classified argv element.
+        // name is the option name without dashes, value is the text after '='
+        // for LONG_WITH_VAL and the whole element for NOT_OP.
+        // Both views point into argv, nothing is copied.
+        struct Token {
+            OptionType type;
+            std::string_view name;
+            std::string_view value;
+        };
+
+        // [A-Za-z0-9_], same as "\w" of std::regex in the "C" locale.
+        inline bool is_word_char(char c) {
+            return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || c == '_';
         }
-        if (idx != nullptr) { 
-            throw std::runtime_error(param + " is not floating point number");
+
+        // Hand-written equivalent of the patterns
+        //   LONG_WITH_VAL : "--[\w|-]*=.*"
+        //   LONG          : "--[\w]*"
+        //   SHORT         : "-[\w][\s\S]*"
+        // examined in this order. Single pass and no allocation.
+        // The name of SHORT is every letter after '-', a cluster such as
+        // "-xvf" or "-j8" is taken apart by the parser.
+        inline Token classify(std::string_view a) {
+            Token t { OptionType::NOT_OP, std::string_view(), a };
+            if (a.size() >= 2 && a[0] == '-' && a[1] == '-') {
+                size_t i = 2;
+                bool word_only = true;
+                for (; i < a.size(); i++) {
+                    char c = a[i];
+                    if (is_word_char(c)) {
+                        continue;
+                    }
+                    if (c == '|' || c == '-') {
+                        word_only = false;
+                        continue;
+                    }
+                    break;
+                }
+                if (i == a.size()) {
+                    if (word_only) {
+                        t.type = OptionType::LONG;
+                        t.name = a.substr(2);
+                        t.value = std::string_view();
+                    }
+                    return t;
+                }
+                if (a[i] == '=') {
+                    // ".*" does not match line terminators.
+                    std::string_view value = a.substr(i+1);
+                    if (value.find('\n') == std::string_view::npos && value.find('\r') == std::string_view::npos) {
+                        t.type = OptionType::LONG_WITH_VAL;
+                        t.name = a.substr(2, i-2);
+                        t.value = value;
+                    }
+                }
+                return t;
+            }
+            if (a.size() >= 2 && a[0] == '-' && is_word_char(a[1])) {
+                t.type = OptionType::SHORT;
+                t.name = a.substr(1);
+                t.value = std::string_view();
+            }
+            return t;
         }
-        return val;
-    }
 
-    template <>
-    std::string convert(const std::string& param) {
-        return param;
+    };  // namespace detail
+
+#if COMMAND_PARSER_EXCEPTIONS
+    // Throwing conversion used by rule. May be specialized for other types.
+    template <class T>
+    T convert(const std::string& param) {
+        if constexpr (std::is_same<T, std::string>::value) {
+            return param;
+        } else {
+            convert_result<T> res = try_convert<T>(param);
+            if (!res) {
+                throw std::runtime_error(param + detail::convert_error<T>());
+            }
+            return res.value;
+        }
     }
 
     template <class T>
@@ -86,13 +256,19 @@ namespace command_parser {
         range(T min, T max) : min_(min), max_(max) { };
 
         bool operator()(const std::string& param) const {
-            T val = convert<T>(param);
-            if (min_ <= val && val <= max_) {
+            return check(convert<T>(param), param);
+        }
+        // Checks an already converted value, param is used for the message.
+        bool check(const T& val, std::string_view param) const {
+            if (contains(val)) {
                 return true;
             }
             std::stringstream range;
             range << "[" << min_ << ", " << max_ << "]";
-            throw std::runtime_error(param + " is out of range. range is " + range.str());
+            throw std::runtime_error(std::string(param) + " is out of range. range is " + range.str());
+        }
+        bool contains(const T& val) const {
+            return min_ <= val && val <= max_;
         }
         const T& min() const {
             return min_;
@@ -105,669 +281,5104 @@ namespace command_parser {
         T max_;
     };
 
-    namespace detail {
+    // The pattern is compiled once and has to match the whole value.
+    class regex {
+    public:
+        explicit regex(std::string pattern, std::regex::flag_type flags = std::regex::ECMAScript | std::regex::optimize) :
+            pattern_(std::move(pattern)), re_(pattern_, flags) { }
 
-        class null_validator {
-        public:
-            null_validator() {}
-            bool operator() (const std::string& str) const {
+        bool operator()(const std::string& param) const {
+            return check(param);
+        }
+        bool check(std::string_view param) const {
+            if (matches(param)) {
                 return true;
             }
-        };
-        static null_validator _null_validator_;
+            throw std::runtime_error(std::string(param) + " does not match " + pattern_);
+        }
+        bool matches(std::string_view param) const {
+            return std::regex_match(param.begin(), param.end(), re_);
+        }
+        const std::string& pattern() const {
+            return pattern_;
+        }
+        std::regex::flag_type flags() const {
+            return re_.flags();
+        }
+    private:
+        std::string pattern_;
+        std::regex re_;
+    };
 
-        template <class T>
-        std::string to_str(T val) {
-            return std::to_string(val);
+    // Where the value of an option came from, later ones win.
+    enum class value_source {
+        default_value,
+        config_file,
+        environment,
+        command_line,
+    };
+
+    // What rule::try_parse rejected.
+    enum class parse_errc {
+        none,
+        unknown_option,         // no option of that name
+        missing_value,          // an option with a value was given without one
+        unexpected_value,       // a flag was given a value
+        malformed,              // neither an option nor an argument
+        invalid_value,          // the value does not convert to the declared type
+        out_of_range,
+        not_candidate,          // not one of the oneof candidates
+        no_match,               // does not match the regex
+        too_long,               // longer than the max length of the parameter
+        validation_failed,      // a user validator returned false or threw
+        missing_argument,
+        too_many_arguments,
+        unknown_command,
+        no_command,
+        response_file,          // an @path file could not be read
+    };
+
+    namespace detail {
+        class Option;
+        class Parameter;
+        class parser;
+    };
+
+    // First invalid argument found by rule::try_parse. Nothing is
+    // formatted until message() is called, which reads names from the
+    // rule, so the rule has to outlive the error.
+    class parse_error {
+    public:
+        explicit operator bool() const {
+            return code_ != parse_errc::none;
+        }
+        parse_errc code() const {
+            return code_;
+        }
+        // Index in argv of the rejected element, the @path element for a
+        // word of a response file, -1 when it did not come from argv.
+        int index() const {
+            return index_;
         }
+        // Long name of the option or name of the parameter, if any.
+        std::string_view id() const;
+        // The rejected text.
+        std::string_view value() const {
+            return value_;
+        }
+        // The message rule::parse_args throws.
+        std::string message() const;
+        // Names near the rejected text: long options for an unknown
+        // option, candidates for a value that is not one of them, and
+        // subcommands for an unknown one. Looked up only on error.
+        std::vector<std::string> suggestions() const;
 
-        template <>
-        std::string to_str(std::string val) {
-            return val;
+    private:
+        friend class rule;
+        friend class detail::parser;
+        // Keeps the first error, malformed arguments replace it by set.
+        void add(parse_errc code, int index, const detail::Option* option, const detail::Parameter* param,
+                 std::string_view value, std::string detail = std::string()) {
+            if (code_ == parse_errc::none) {
+                set(code, index, option, param, value, std::move(detail));
+            }
+        }
+        void set(parse_errc code, int index, const detail::Option* option, const detail::Parameter* param,
+                 std::string_view value, std::string detail = std::string()) {
+            code_ = code;
+            index_ = index;
+            option_ = option;
+            param_ = param;
+            value_.assign(value);
+            detail_ = std::move(detail);
+            suggestions_.clear();
         }
+        std::string base_message() const;
 
-        // long name style is  "--long_name"
-        // short name style is "-short_name"
-        class Option {
-            using Validator = std::function<bool(const std::string&)>;
+        parse_errc code_ = parse_errc::none;
+        int index_ = -1;
+        const detail::Option* option_ = nullptr;
+        const detail::Parameter* param_ = nullptr;
+        std::string value_;
+        std::string detail_;    // what a user validator or converter threw
+        std::vector<std::string> suggestions_;
+    };
+
+#if COMMAND_PARSER_STATS
+    // Where the time of one sampled parse went, see
+    // rule::set_stats_observer. Times are steady_clock nanoseconds, the
+    // phases add up to about total_ns. Elements of list options are
+    // converted and checked in one pass, which counts as conversion.
+    struct parse_stats {
+        struct validator_time {
+            std::string_view name;      // long name of the option or name of the parameter
+            uint64_t ns;
+            size_t calls;
+        };
+
+        uint64_t total_ns = 0;
+        uint64_t tokenize_ns = 0;       // reading and classifying argv and response files
+        uint64_t option_ns = 0;         // binding options, the environment and the config file
+        uint64_t positional_ns = 0;     // binding arguments to parameters
+        uint64_t validation_ns = 0;     // ranges, candidates, patterns and user validators
+        uint64_t conversion_ns = 0;     // text to the declared type
+        size_t tokens = 0;              // argv elements and response file words read
+        size_t options = 0;
+        size_t arguments = 0;
+        size_t allocations = 0;         // from the memory resource of the result
+        size_t allocated_bytes = 0;
+        bool failed = false;
+        // User validators in the order they first ran, also counted in
+        // validation_ns.
+        std::vector<validator_time> validators;
+    };
+#endif
+
+    namespace detail {
+
+        enum class Phase {
+            tokenize,
+            option,
+            positional,
+            validation,
+            conversion,
+        };
+
+#if COMMAND_PARSER_STATS
+        // Charges the time of a sampled parse to its phases. Each lap ends
+        // a phase, so a parse reads the clock once per phase it goes
+        // through.
+        class Probe {
         public:
-            Option(std::string lname, char sname, std::string message, Validator v = _null_validator_) : 
-                lname_(lname),
-                sname_(1, sname),
-                message_(message),
-                validator(v)
-            {
-            }
-            bool has_value() const {
-                return has_value_;
-            }
-            void set_validator(Validator v) {
-                validator = v;
-            }
+            explicit Probe(parse_stats& stats) : stats(stats), last_(clock::now()) { }
 
-            bool use() const {
-                return is_use_;
-            }
-            bool use(bool b) {
-                is_use_ = b;
-                return use();
-            }
-            const std::string& value() const {
-                if(has_value_ == false) {
-                    throw std::logic_error("Don't has a value.");
-                }
-                return value_;
+            void lap(Phase phase) {
+                stats.*phases[(int)phase] += elapsed();
             }
-            const std::string& value(std::string value) {
-                if(has_value_ == false) {
-                    throw std::logic_error("Don't has a value.");
+            // A user validator that just ran for the option or parameter name.
+            void lap_validator(std::string_view name) {
+                uint64_t ns = elapsed();
+                stats.validation_ns += ns;
+                auto it = std::find_if(stats.validators.begin(), stats.validators.end(),
+                                       [&](const parse_stats::validator_time& v) { return v.name == name; });
+                if (it == stats.validators.end()) {
+                    stats.validators.push_back(parse_stats::validator_time{name, ns, 1});
+                } else {
+                    it->ns += ns;
+                    it->calls++;
                 }
-                value_ = value;
-                use(true);
-                return value_;
-            }
-            const std::string& long_name() const {
-                return lname_;
             }
-            char short_name() const {
-                return sname_.at(0);
+            void option_bound() {
+                stats.options++;
             }
-            const std::string& message() const {
-                return message_;
+            void argument_bound() {
+                stats.arguments++;
             }
-            bool validate() const {
-                try {
-                    return validator(value_);
-                } catch (std::runtime_error& e) {
-                    std::string mes = "\"--" + lname_ + "(-" + sname_ + ")\" validation failed. ";
-                    mes += e.what();
-                    throw std::runtime_error(mes);
-                }
+
+            parse_stats& stats;
+
+        private:
+            using clock = std::chrono::steady_clock;
+            static constexpr uint64_t parse_stats::* phases[] = {
+                &parse_stats::tokenize_ns,
+                &parse_stats::option_ns,
+                &parse_stats::positional_ns,
+                &parse_stats::validation_ns,
+                &parse_stats::conversion_ns,
+            };
+
+            uint64_t elapsed() {
+                clock::time_point now = clock::now();
+                uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count();
+                last_ = now;
+                return ns;
             }
 
-        protected:
-            std::string lname_;
-            std::string sname_;
-            std::string message_;
-            Validator validator;
-            bool has_value_ = false;
-            std::string value_ = "";
-            bool is_use_ = false;
+            clock::time_point last_;
         };
-
-        // long name style is  "--long_name=value"
-        // short name style is "-short_name value"
-        class ValueOption : public Option {
-            using Validator = std::function<bool(const std::string&)>;
+#else
+        // Nothing is measured, the calls compile to nothing.
+        class Probe {
         public:
-            ValueOption(std::string lname, char sname, std::string message, std::string def_val, Validator v = _null_validator_) : 
-                Option(lname, sname, message)
-            {
-                has_value_ = true;
-                value_ = def_val;
-                set_validator(v);
-            }
+            void lap(Phase) { }
+            void lap_validator(std::string_view) { }
+            void option_bound() { }
+            void argument_bound() { }
+        };
+#endif
 
-            template <class T>
-            ValueOption(std::string lname, char sname, std::string message, std::string def_val, range<T> r) : 
-                Option(lname, sname, message)
-            {
-                has_value_ = true;
-                value_ = def_val;
-                set_validator(r);
-                message_ += " : range is [" + to_str(r.min()) + ", " + to_str(r.max()) + "]";
+        class null_validator {
+        public:
+            null_validator() {}
+            bool operator() (const std::string&) const {
+                return true;
             }
         };
+        static null_validator _null_validator_;
 
-        class WithCandidateValueOption : public ValueOption {
+        // Holds one converted value of any type. Types that fit the inline
+        // buffer (arithmetic types, std::string, std::vector) are stored in
+        // place, larger ones in the memory resource.
+        class typed_value {
         public:
-            template <class T>
-                WithCandidateValueOption(std::string lname, char sname, std::string message, std::string def_val, std::vector<T> candidates) : 
-                    ValueOption(lname, sname, message, def_val)
+            explicit typed_value(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+                resource_(resource)
             {
-                to_str_candidates(candidates);
-                set_validator(std::bind(&WithCandidateValueOption::validate_candidates, std::ref(*this), std::placeholders::_1));
-
-                message_ += " : Available pattern {";
-                bool first=true;
-                for(const auto& c : candidates_) {
-                    if( first ) {
-                        message_ += c;
-                        first = false;
-                    } else {
-                        message_ += ", " + c;
-                    }
-                }
-                message_ += "}";
             }
-
-            bool validate_candidates(const std::string& param) const {
-                if ( candidates_.count(param) == 0 ) { 
-                    throw std::runtime_error("--" + long_name() + "(-" + short_name() + ") cannot specify the \"" + param + "\"");
+            typed_value(const typed_value& other) : resource_(other.resource_) {
+                if (other.ops_) {
+                    other.ops_->copy(other, *this);
                 }
-
-                return true;
             }
-
-        private:
-            template <class T>
-            void to_str_candidates(std::vector<T> cand) {
-                for(auto v : cand) {
-                    candidates_.insert(detail::to_str(v));
+            typed_value(typed_value&& other) noexcept : resource_(other.resource_) {
+                if (other.ops_) {
+                    other.ops_->move(other, *this);
                 }
             }
-
-            std::set<std::string> candidates_;
-        };
-
-        class OptionsInfo{
-        public:
-            OptionsInfo() {}
-
-            void add(std::unique_ptr<Option> op) {
-                if(is_exist(op->short_name())) {
-                    throw std::logic_error("duplicated option");
-                }
-                if(is_exist(op->long_name())) {
-                    throw std::logic_error("duplicated option");
+            typed_value& operator=(const typed_value& other) {
+                if (this != &other) {
+                    reset();
+                    if (other.ops_) {
+                        other.ops_->copy(other, *this);
+                    }
                 }
-                if(op->long_name().length() > max_lname_length) {
-                    max_lname_length = op->long_name().length();
+                return *this;
+            }
+            typed_value& operator=(typed_value&& other) noexcept {
+                if (this != &other) {
+                    reset();
+                    if (other.ops_) {
+                        other.ops_->move(other, *this);
+                    }
                 }
-                short_long_map.insert(std::make_pair(op->short_name(), op->long_name()));
-                options_.insert(std::make_pair(op->long_name(), std::move(op)));
+                return *this;
             }
-            int get_max_length() const {
-                return max_lname_length;
+            ~typed_value() {
+                reset();
             }
-            bool is_exist(const std::string& long_name) const {
-                return options_.count(long_name) == 1;
+
+            template <class T, class ... Args>
+            T& emplace(Args&& ... args) {
+                reset();
+                if constexpr (is_inline<T>()) {
+                    ptr_ = new (buf_) T(std::forward<Args>(args)...);
+                } else {
+                    void* p = resource_->allocate(sizeof(T), alignof(T));
+                    try {
+                        ptr_ = new (p) T(std::forward<Args>(args)...);
+                    } catch (...) {
+                        resource_->deallocate(p, sizeof(T), alignof(T));
+                        throw;
+                    }
+                }
+                ops_ = &ops_of<T>();
+                return *static_cast<T*>(ptr_);
             }
-            bool is_exist(char short_name) const {
-                return short_long_map.count(short_name) == 1;
+
+            // nullptr when empty or holding another type.
+            template <class T>
+            const T* get() const {
+                return ops_ == &ops_of<T>() ? static_cast<const T*>(ptr_) : nullptr;
             }
-            void set(const std::string& long_name) {
-                options_[long_name]->use(true);
+            template <class T>
+            T* get() {
+                return ops_ == &ops_of<T>() ? static_cast<T*>(ptr_) : nullptr;
             }
-            void set(const std::string& long_name, const std::string& value) {
-                set(long_name);
-                options_[long_name]->value(value);
+
+            bool empty() const {
+                return ops_ == nullptr;
             }
-            bool is_use(const std::string& long_name) const {
-                if(is_exist(long_name) == false) {
-                    throw std::logic_error("Undefined parameter.");
-                }
-                return options_.at(long_name)->use();
+            const void* data() const {
+                return ptr_;
             }
-            bool has_value(const std::string& long_name) const {
-                if(is_exist(long_name) == false) {
-                    throw std::runtime_error("Parameter invalid");
-                }
-                return options_.at(long_name)->has_value();
-
+            std::pmr::memory_resource* resource() const {
+                return resource_;
             }
-            bool has_value(char short_name) const {
-                if(is_exist(short_name) == false) {
-                    throw std::runtime_error("Parameter invalid");
+            void reset() {
+                if (ops_) {
+                    ops_->destroy(*this);
+                    ops_ = nullptr;
+                    ptr_ = nullptr;
                 }
-
-                return options_.at(short_long_map.at(short_name))->has_value();
             }
 
+        private:
+            struct ops {
+                void (*destroy)(typed_value&);
+                void (*copy)(const typed_value&, typed_value&);
+                void (*move)(typed_value&, typed_value&);
+            };
+
             template <class T>
-            T get_value(const std::string& long_name) const {
-                if(is_exist(long_name) == false) {
-                    throw std::logic_error(long_name + "is not defined.");
-                }
-                return convert<T>(options_.at(long_name)->value());
+            static constexpr bool is_inline() {
+                return sizeof(T) <= sizeof(buf_) && alignof(T) <= alignof(std::max_align_t)
+                    && std::is_nothrow_move_constructible<T>::value;
             }
 
-            const std::string& to_long_name(char short_name) const {
-                if(is_exist(short_name) == false) {
-                    throw std::runtime_error("Option name invalid");
-                }
-
-                return short_long_map.at(short_name);
+            template <class T>
+            static const ops& ops_of() {
+                static const ops o {
+                    [](typed_value& v) {
+                        static_cast<T*>(v.ptr_)->~T();
+                        if constexpr (!is_inline<T>()) {
+                            v.resource_->deallocate(v.ptr_, sizeof(T), alignof(T));
+                        }
+                    },
+                    [](const typed_value& from, typed_value& to) {
+                        to.emplace<T>(*static_cast<const T*>(from.ptr_));
+                    },
+                    [](typed_value& from, typed_value& to) {
+                        if constexpr (is_inline<T>()) {
+                            to.ptr_ = new (to.buf_) T(std::move(*static_cast<T*>(from.ptr_)));
+                            to.ops_ = from.ops_;
+                            from.reset();
+                        } else if (from.resource_ != to.resource_) {
+                            to.emplace<T>(std::move(*static_cast<T*>(from.ptr_)));
+                            from.reset();
+                        } else {
+                            to.ptr_ = from.ptr_;
+                            to.ops_ = from.ops_;
+                            from.ptr_ = nullptr;
+                            from.ops_ = nullptr;
+                        }
+                    },
+                };
+                return o;
             }
 
-            auto begin() { return options_.begin(); }
-            const auto begin() const { return options_.begin(); }
-
-            auto end() { return options_.end(); }
-            const auto end() const { return options_.end(); }
-
-            bool empty() const {
-                return options_.empty();
-            }
-        private:
-            int max_lname_length = 0;
-            std::map<char, std::string> short_long_map;
-            std::map<std::string, std::unique_ptr<Option>> options_;
+            alignas(std::max_align_t) unsigned char buf_[32];
+            void* ptr_ = nullptr;
+            const ops* ops_ = nullptr;
+            std::pmr::memory_resource* resource_;
         };
 
-        class Parameter {
-            using Validator = std::function<bool(const std::string&)>;
+        // std::function whose target is allocated from a memory resource.
+        template <class Signature>
+        class pmr_function;
+
+        template <class R, class ... Args>
+        class pmr_function<R(Args...)> {
         public:
-            Parameter(int order, std::string name, std::string message, Validator v = _null_validator_) :
-                order_(order),
-                name_(name),
-                message_(message),
-                validator(v)
+            pmr_function() {}
+            template <class F>
+            pmr_function(F f, std::pmr::memory_resource* resource) :
+                resource_(resource)
             {
+                void* p = resource_->allocate(sizeof(F), alignof(F));
+                try {
+                    target_ = new (p) F(std::move(f));
+                } catch (...) {
+                    resource_->deallocate(p, sizeof(F), alignof(F));
+                    throw;
+                }
+                ops_ = &ops_of<F>();
             }
-            int get_order() const {
-                return order_;
+            pmr_function(const pmr_function& other) : resource_(other.resource_) {
+                if (other.ops_) {
+                    target_ = other.ops_->clone(other.target_, resource_);
+                    ops_ = other.ops_;
+                }
             }
-            void set_validator(Validator v) {
-                validator = v;
+            pmr_function(pmr_function&& other) noexcept {
+                swap(other);
             }
-
-            // TODO
-            void set(const std::string& value) {
-                value_ = value;
+            pmr_function& operator=(pmr_function other) noexcept {
+                swap(other);
+                return *this;
+            }
+            ~pmr_function() {
+                if (ops_) {
+                    ops_->destroy(target_, resource_);
+                }
             }
 
-            const std::string& value() const {
-                return value_;
+            explicit operator bool() const {
+                return ops_ != nullptr;
             }
-            const std::string& value(const std::string& value) {
-                value_ = value;
-                return value_;
+            R operator()(Args ... args) const {
+                return ops_->invoke(target_, std::forward<Args>(args)...);
             }
 
-            bool is_use() const {
-                return value_.length() != 0;
-            }
+        private:
+            struct ops {
+                R (*invoke)(void*, Args&&...);
+                void* (*clone)(const void*, std::pmr::memory_resource*);
+                void (*destroy)(void*, std::pmr::memory_resource*);
+            };
 
-            const std::string& name() const {
-                return name_;
-            }
-            const std::string& message() const {
-                return message_;
+            template <class F>
+            static const ops& ops_of() {
+                static const ops o {
+                    [](void* f, Args&& ... args) -> R {
+                        return (*static_cast<F*>(f))(std::forward<Args>(args)...);
+                    },
+                    [](const void* f, std::pmr::memory_resource* r) -> void* {
+                        void* p = r->allocate(sizeof(F), alignof(F));
+                        try {
+                            return new (p) F(*static_cast<const F*>(f));
+                        } catch (...) {
+                            r->deallocate(p, sizeof(F), alignof(F));
+                            throw;
+                        }
+                    },
+                    [](void* f, std::pmr::memory_resource* r) {
+                        static_cast<F*>(f)->~F();
+                        r->deallocate(f, sizeof(F), alignof(F));
+                    },
+                };
+                return o;
             }
-            bool validate() const {
-                if (value_ == "") {
-                    std::stringstream mes;
-                    mes << "The " << order_ << "(" + name_ + ")" << " argument is not specified.";
-                    throw std::runtime_error(mes.str());
-                }
-                try {
-                    return validator(value_);
-                } catch (std::runtime_error& e) {
-                    std::string mes = "\"" + name_ + "\" validation failed. ";
-                    mes += e.what();
-                    throw std::runtime_error(mes);
-                }
+
+            void swap(pmr_function& other) noexcept {
+                std::swap(target_, other.target_);
+                std::swap(ops_, other.ops_);
+                std::swap(resource_, other.resource_);
             }
 
-        protected:
-            int order_;
-            std::string name_;
-            std::string message_;
-            Validator validator;
-            std::string value_ = "";
+            void* target_ = nullptr;
+            const ops* ops_ = nullptr;
+            std::pmr::memory_resource* resource_ = nullptr;
         };
 
         template <class T>
-        class RangeParameter : public Parameter {
-        public:
-            RangeParameter(int order, std::string name, std::string message, range<T> r) :
-                Parameter(order, name, message),
-                r_(r)
-            {
-                set_validator(std::bind(&RangeParameter::validate_range, std::ref(*this), std::placeholders::_1));
-
-                message_ += " : range is [" + to_str(r.min()) + ", " + to_str(r.max()) + "]";
-            }
-
-            bool validate_range(const std::string& param) const {
-                return r_(param);
-            }
-
-        private:
+        const void* type_id() {
+            static const char id = 0;
+            return &id;
+        }
 
-            range<T> r_;
+        // Conversion of the type an option or parameter was declared with.
+        struct ValueType {
+            const void* id;
+            bool is_string;
+            // false when raw does not convert. A convert<T> specialization
+            // that throws leaves its message in detail.
+            bool (*convert)(std::string_view raw, typed_value& out, std::string& detail);
+            void (*append)(typed_value& element, typed_value& list);
+            // Converts raw onto the end of list, returns the new element or
+            // nullptr like convert.
+            const void* (*convert_append)(std::string_view raw, typed_value& list, std::string& detail);
+            void (*reserve)(typed_value& list, size_t n);
+            const char* error;      // convert_error<T>() for try_convert types
         };
-        class StringParameter : public Parameter {
-            using Validator = std::function<bool(const std::string&)>;
-        public:
-            StringParameter(int order, std::string name, std::string message, int max_length, Validator v = detail::_null_validator_) :
-                Parameter(order, name, message),
-                max_length_(max_length),
-                str_validator_(v)
-            {
-                set_validator(
-                        [this](const std::string& param) -> bool {
-                            if (this->max_length_ < param.length()) {
-                                throw std::runtime_error("Over-length error. Max length of \"" + this->name() +  + "\" is " + to_str(max_length_) + ".");
-                            }
-                            return this->str_validator_(param);
-                        }
-                        );
 
-            }
+        template <class T>
+        struct is_try_convertible : std::integral_constant<bool,
+            std::is_arithmetic<T>::value || std::is_same<T, std::string_view>::value> {};
+
+        // convert<T> without building a std::string for the types
+        // try_convert supports.
+        template <class T>
+        T convert_view(std::string_view raw) {
+            if constexpr (std::is_same<T, std::string>::value) {
+                return std::string(raw);
+            } else if constexpr (is_try_convertible<T>::value) {
+                convert_result<T> res = try_convert<T>(raw);
+                if (!res) {
+                    throw std::runtime_error(std::string(raw) + convert_error<T>());
+                }
+                return res.value;
+            } else {
+                return command_parser::convert<T>(std::string(raw));
+            }
+        }
+
+        template <class T>
+        const ValueType& value_type_of() {
+            static const ValueType t {
+                type_id<T>(),
+                std::is_same<T, std::string>::value,
+                [](std::string_view raw, typed_value& out, std::string& detail) {
+                    if constexpr (std::is_same<T, std::string>::value) {
+                        out.emplace<T>(raw);
+                    } else if constexpr (is_try_convertible<T>::value) {
+                        convert_result<T> res = try_convert<T>(raw);
+                        if (!res) {
+                            return false;
+                        }
+                        out.emplace<T>(res.value);
+                    } else {
+                        try {
+                            out.emplace<T>(command_parser::convert<T>(std::string(raw)));
+                        } catch (std::runtime_error& e) {
+                            detail = e.what();
+                            return false;
+                        }
+                    }
+                    return true;
+                },
+                [](typed_value& element, typed_value& list) {
+                    std::vector<T>* l = list.get<std::vector<T>>();
+                    if (l == nullptr) {
+                        l = &list.emplace<std::vector<T>>();
+                    }
+                    l->push_back(std::move(*element.get<T>()));
+                },
+                [](std::string_view raw, typed_value& list, std::string& detail) -> const void* {
+                    std::vector<T>* l = list.get<std::vector<T>>();
+                    if (l == nullptr) {
+                        l = &list.emplace<std::vector<T>>();
+                    }
+                    if constexpr (is_try_convertible<T>::value) {
+                        convert_result<T> res = try_convert<T>(raw);
+                        if (!res) {
+                            return nullptr;
+                        }
+                        return &l->emplace_back(res.value);
+                    } else if constexpr (std::is_same<T, std::string>::value) {
+                        return &l->emplace_back(raw);
+                    } else {
+                        try {
+                            return &l->emplace_back(command_parser::convert<T>(std::string(raw)));
+                        } catch (std::runtime_error& e) {
+                            detail = e.what();
+                            return nullptr;
+                        }
+                    }
+                },
+                [](typed_value& list, size_t n) {
+                    std::vector<T>* l = list.get<std::vector<T>>();
+                    if (l == nullptr) {
+                        l = &list.emplace<std::vector<T>>();
+                    }
+                    l->reserve(n);
+                },
+                is_try_convertible<T>::value ? convert_error<T>() : nullptr,
+            };
+            return t;
+        }
+
+        using Validator = pmr_function<bool(const std::string&)>;
+        // Range check on a converted value and its text, "range is [1, 9]".
+        using RangeCheck = pmr_function<bool(const void*)>;
+        using Describe = pmr_function<void(std::string&)>;
+
+        // Bounds of a range over an arithmetic type, kept as bytes for
+        // rule::save_schema.
+        struct RangeBounds {
+            bool set = false;
+            unsigned char min[16] = {};
+            unsigned char max[16] = {};
+
+            template <class T>
+            void assign(const range<T>& r) {
+                if constexpr (std::is_arithmetic<T>::value && sizeof(T) <= sizeof(min)) {
+                    T lo = r.min(), hi = r.max();
+                    std::memcpy(min, &lo, sizeof(T));
+                    std::memcpy(max, &hi, sizeof(T));
+                    set = true;
+                }
+            }
+            template <class T>
+            range<T> get() const {
+                T lo, hi;
+                std::memcpy(&lo, min, sizeof(T));
+                std::memcpy(&hi, max, sizeof(T));
+                return range<T>(lo, hi);
+            }
+        };
+
+        // The types a schema image can declare, by their index here.
+        using SchemaTypes = std::tuple<char, signed char, unsigned char, short, unsigned short,
+                                       int, unsigned int, long, unsigned long, long long, unsigned long long,
+                                       float, double, long double, std::string>;
+        constexpr uint32_t no_schema_type = 0xff;
+
+        template <size_t ... I>
+        uint32_t schema_type_code(const ValueType* type, std::index_sequence<I...>) {
+            uint32_t code = no_schema_type;
+            ((type->id == type_id<std::tuple_element_t<I, SchemaTypes>>() ? (void)(code = I) : (void)0), ...);
+            return code;
+        }
+        inline uint32_t schema_type_code(const ValueType* type) {
+            return schema_type_code(type, std::make_index_sequence<std::tuple_size<SchemaTypes>::value>());
+        }
+        // Calls f with a null pointer to the type of code. false for an
+        // unknown code.
+        template <class F, size_t ... I>
+        bool with_schema_type(uint32_t code, F f, std::index_sequence<I...>) {
+            return ((code == I ? (f((std::tuple_element_t<I, SchemaTypes>*)nullptr), true) : false) || ...);
+        }
+        template <class F>
+        bool with_schema_type(uint32_t code, F f) {
+            return with_schema_type(code, f, std::make_index_sequence<std::tuple_size<SchemaTypes>::value>());
+        }
+
+        // User validators may also throw std::runtime_error, its message
+        // goes to detail.
+        inline parse_errc call_validator(const Validator& v, std::string_view raw, std::string& detail) {
+            if (!v) {
+                return parse_errc::none;
+            }
+            try {
+                if (v(std::string(raw))) {
+                    return parse_errc::none;
+                }
+            } catch (std::runtime_error& e) {
+                detail = e.what();
+            }
+            return parse_errc::validation_failed;
+        }
+
+        // Value of an option or a parameter declared as type.
+        // Asking for another type is a logic error, the stored string is
+        // only converted when nothing was validated yet.
+        template <class T>
+        T typed_get(const ValueType* type, const typed_value& typed, std::string_view raw, const std::string& name) {
+            if (type != nullptr && type->id != type_id<T>()) {
+                throw std::logic_error(name + " is not of the requested type.");
+            }
+            if (const T* v = typed.get<T>()) {
+                return *v;
+            }
+            return convert_view<T>(raw);
+        }
+
+        template <class T>
+        const T& typed_ref(const ValueType* type, const typed_value& typed, const std::string& name) {
+            if (type != nullptr && type->id != type_id<T>()) {
+                throw std::logic_error(name + " is not of the requested type.");
+            }
+            if (const T* v = typed.get<T>()) {
+                return *v;
+            }
+            throw std::logic_error(name + " has no converted value.");
+        }
+
+        // User validators receive a std::string, so they are only called
+        // when one was given.
+        template <class F>
+        Validator user_validator(F v, std::pmr::memory_resource* resource) {
+            if constexpr (std::is_same<F, null_validator>::value) {
+                return Validator();
+            } else if constexpr (std::is_same<F, std::function<bool(const std::string&)>>::value) {
+                if (!v || v.template target<null_validator>() != nullptr) {
+                    return Validator();
+                }
+            }
+            return Validator(std::move(v), resource);
+        }
+
+        // Text owned in a memory resource, or borrowed from a schema image
+        // that outlives it. Moving keeps a borrowed view valid.
+        class Text {
+        public:
+            Text(std::string_view text, std::pmr::memory_resource* resource) : owned_(text, resource) { }
+            explicit Text(std::pmr::memory_resource* resource) : owned_(resource) { }
+
+            Text& operator=(std::string_view text) {
+                owned_.assign(text);
+                borrowed_ = false;
+                return *this;
+            }
+            Text& operator+=(std::string_view text) {
+                owned_ += text;
+                return *this;
+            }
+            void borrow(std::string_view text) {
+                owned_.clear();
+                view_ = text;
+                borrowed_ = true;
+            }
+            void clear() {
+                owned_.clear();
+                borrowed_ = false;
+            }
+
+            operator std::string_view() const {
+                return borrowed_ ? view_ : std::string_view(owned_);
+            }
+            size_t size() const {
+                return borrowed_ ? view_.size() : owned_.size();
+            }
+            std::pmr::memory_resource* resource() const {
+                return owned_.get_allocator().resource();
+            }
 
         private:
-            int max_length_;
-            Validator str_validator_;
+            std::pmr::string owned_;
+            std::string_view view_;
+            bool borrowed_ = false;
         };
 
-        class ParametersInfo{
+        // Levenshtein distance of one word to many. Words of up to 64
+        // characters use the bit-parallel algorithm of Myers in the form
+        // given by Hyyrö, one pass of a few word operations per character
+        // of the other text. Longer words fall back to the table.
+        class EditDistance {
         public:
-            ParametersInfo() {}
+            explicit EditDistance(std::string_view word) : word_(word) {
+                peq_.fill(0);
+                for (size_t i = 0; i < word.size() && i < 64; i++) {
+                    peq_[(unsigned char)word[i]] |= uint64_t(1) << i;
+                }
+            }
 
-            void add(std::unique_ptr<Parameter> op) {
-                if(order_map_.count(op->name()) != 0) {
-                    throw std::logic_error("duplicated option");
+            // The distance to text, or some value above max as soon as it
+            // is known to be more than max.
+            size_t operator()(std::string_view text, size_t max) const {
+                size_t m = word_.size();
+                if ((m > text.size() ? m - text.size() : text.size() - m) > max) {
+                    return max + 1;
+                }
+                if (m == 0) {
+                    return text.size();
+                }
+                if (m > 64) {
+                    return table(text);
+                }
+                uint64_t last = uint64_t(1) << (m - 1);
+                uint64_t pv = ~uint64_t(0);
+                uint64_t mv = 0;
+                size_t score = m;
+                for (size_t j = 0; j < text.size(); j++) {
+                    uint64_t eq = peq_[(unsigned char)text[j]];
+                    uint64_t xv = eq | mv;
+                    uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+                    uint64_t ph = mv | ~(xh | pv);
+                    uint64_t mh = pv & xh;
+                    if (ph & last) {
+                        score++;
+                    } else if (mh & last) {
+                        score--;
+                    }
+                    // Each character left can lower the score by one.
+                    if (score > max + (text.size() - j - 1)) {
+                        return max + 1;
+                    }
+                    ph = (ph << 1) | 1;
+                    mh <<= 1;
+                    pv = mh | ~(xv | ph);
+                    mv = ph & xv;
+                }
+                return score;
+            }
+
+        private:
+            size_t table(std::string_view text) const {
+                std::vector<size_t> row(text.size() + 1);
+                for (size_t j = 0; j <= text.size(); j++) {
+                    row[j] = j;
+                }
+                for (size_t i = 1; i <= word_.size(); i++) {
+                    size_t diagonal = row[0];
+                    row[0] = i;
+                    for (size_t j = 1; j <= text.size(); j++) {
+                        size_t up = row[j];
+                        row[j] = std::min({up + 1, row[j - 1] + 1, diagonal + (word_[i - 1] != text[j - 1])});
+                        diagonal = up;
+                    }
+                }
+                return row[text.size()];
+            }
+
+            std::string_view word_;
+            std::array<uint64_t, 256> peq_;
+        };
+
+        // Ids of names ordered by the length of the name, kept up to date
+        // as names are added. A name whose length differs by more than a
+        // bound is farther than that bound, so only a slice is compared.
+        class LengthIndex {
+        public:
+            explicit LengthIndex(std::pmr::memory_resource* resource) : entries_(resource) { }
+
+            void insert(uint32_t id, size_t length) {
+                Entry e{(uint32_t)length, id};
+                entries_.insert(std::upper_bound(entries_.begin(), entries_.end(), e), e);
+            }
+            // Adds without keeping the order, for many names at once.
+            // Call sort after the last one.
+            void push_back(uint32_t id, size_t length) {
+                entries_.emplace_back((uint32_t)length, id);
+            }
+            void sort() {
+                std::sort(entries_.begin(), entries_.end());
+            }
+            void clear() {
+                entries_.clear();
+            }
+
+            // (length, id) pairs in order, for a schema image.
+            using Entry = std::pair<uint32_t, uint32_t>;
+            const std::pmr::vector<Entry>& entries() const {
+                return entries_;
+            }
+            void assign(std::pmr::vector<Entry> entries) {
+                entries_ = std::move(entries);
+            }
+
+            // Calls f(id) for the names of length - max ... length + max.
+            template <class F>
+            void near(size_t length, size_t max, F f) const {
+                uint32_t low = (uint32_t)(length > max ? length - max : 0);
+                auto it = std::lower_bound(entries_.begin(), entries_.end(), Entry{low, 0});
+                for (; it != entries_.end() && it->first <= length + max; ++it) {
+                    f(it->second);
+                }
+            }
+        private:
+            std::pmr::vector<Entry> entries_;
+        };
+
+        // The names nearest to a mistyped word, at least one and at most
+        // a third of its length edits away, so words shorter than three
+        // characters get none. Only the closest distance found is kept.
+        class Suggestions {
+        public:
+            static constexpr size_t max_count = 3;
+
+            explicit Suggestions(std::string_view word) :
+                distance_(word),
+                length_(word.size()),
+                best_(word.size() / 3)
+            {
+            }
+
+            void consider(std::string_view name) {
+                size_t d = distance_(name, best_);
+                if (d > best_ || d == 0) {
+                    return;
+                }
+                if (d < best_) {
+                    names_.clear();
+                    best_ = d;
+                }
+                names_.push_back(name);
+            }
+            // Names of index, name(id) gives the name of an id.
+            template <class Name>
+            void consider(const LengthIndex& index, Name name) {
+                index.near(length_, best_, [&](uint32_t id) {
+                    consider(name(id));
+                });
+            }
+
+            // The nearest names in order, each with prefix in front.
+            std::vector<std::string> take(std::string_view prefix = std::string_view()) {
+                std::sort(names_.begin(), names_.end());
+                names_.erase(std::unique(names_.begin(), names_.end()), names_.end());
+                std::vector<std::string> out;
+                for (size_t i = 0; i < names_.size() && i < max_count; i++) {
+                    out.push_back(std::string(prefix).append(names_[i]));
+                }
+                return out;
+            }
+
+        private:
+            EditDistance distance_;
+            size_t length_;
+            size_t best_;
+            std::vector<std::string_view> names_;
+        };
+
+        // " Did you mean "a" or "b"?" for the end of an error message.
+        inline void append_suggestions(std::string& out, const std::vector<std::string>& names) {
+            for (size_t i = 0; i < names.size(); i++) {
+                out += i == 0 ? " Did you mean \"" : "\" or \"";
+                out += names[i];
+            }
+            if (!names.empty()) {
+                out += "\"?";
+            }
+        }
+
+        // Candidate strings packed in one buffer, found by binary search
+        // over (offset, length) pairs sorted by the strings.
+        class CandidateSet {
+        public:
+            explicit CandidateSet(std::pmr::memory_resource* resource) :
+                text_(resource), index_(resource), lengths_(resource) { }
+
+            using Entry = std::pair<uint32_t, uint32_t>;
+
+            void add(std::string_view c) {
+                index_.emplace_back(text_.size(), c.size());
+                text_ += c;
+            }
+            // Sorts and drops duplicates, call after the last add.
+            void seal() {
+                auto less = [this](const Entry& a, const Entry& b) { return str(a) < str(b); };
+                auto equal = [this](const Entry& a, const Entry& b) { return str(a) == str(b); };
+                std::sort(index_.begin(), index_.end(), less);
+                index_.erase(std::unique(index_.begin(), index_.end(), equal), index_.end());
+                lengths_.clear();
+                for (size_t i = 0; i < index_.size(); i++) {
+                    lengths_.push_back((uint32_t)i, index_[i].second);
+                }
+                lengths_.sort();
+            }
+            void suggest(Suggestions& s) const {
+                s.consider(lengths_, [this](uint32_t i) { return str(index_[i]); });
+            }
+            bool contains(std::string_view c) const {
+                auto it = std::lower_bound(index_.begin(), index_.end(), c,
+                        [this](const Entry& e, std::string_view v) { return str(e) < v; });
+                return it != index_.end() && str(*it) == c;
+            }
+            bool empty() const {
+                return index_.empty();
+            }
+            size_t size() const {
+                return index_.size();
+            }
+            std::string_view operator[](size_t i) const {
+                return str(index_[i]);
+            }
+
+            // The packed text and the sorted (offset, length) pairs, for a
+            // schema image.
+            std::string_view text() const {
+                return text_;
+            }
+            const std::pmr::vector<Entry>& entries() const {
+                return index_;
+            }
+            const LengthIndex& lengths() const {
+                return lengths_;
+            }
+            // Candidates that are already sealed, as (offset, length) pairs
+            // into text, which has to outlive the set.
+            void borrow(std::string_view text, std::pmr::vector<Entry> entries, std::pmr::vector<LengthIndex::Entry> lengths) {
+                text_.borrow(text);
+                index_ = std::move(entries);
+                lengths_.assign(std::move(lengths));
+            }
+
+        private:
+            std::string_view str(const Entry& e) const {
+                return std::string_view(text_).substr(e.first, e.second);
+            }
+            Text text_;
+            std::pmr::vector<Entry> index_;
+            LengthIndex lengths_;
+        };
+
+        // Words sorted into one buffer and indexed by a trie. The words
+        // under a node are contiguous, so a node keeps their range and a
+        // prefix is answered by one walk from the root. Each word carries
+        // a tag for the caller.
+        class PrefixTrie {
+        public:
+            explicit PrefixTrie(std::pmr::memory_resource* resource) :
+                text_(resource), words_(resource), nodes_(resource) { }
+
+            void clear() {
+                text_.clear();
+                words_.clear();
+                nodes_.clear();
+            }
+            void add(std::string_view word, uint8_t tag) {
+                words_.push_back(Word{(uint32_t)text_.size(), (uint32_t)word.size(), tag});
+                text_ += word;
+            }
+            // Sorts the words and builds the nodes breadth first, so the
+            // children of a node are stored next to each other in the
+            // order of their character. Call after the last add.
+            void seal() {
+                std::sort(words_.begin(), words_.end(), [this](const Word& a, const Word& b) {
+                    return str(a) < str(b);
+                });
+                nodes_.clear();
+                nodes_.push_back(Node{0, 0, 0, (uint32_t)words_.size(), 0, '\0'});
+                for (size_t n = 0; n < nodes_.size(); n++) {
+                    Node node = nodes_[n];
+                    uint32_t i = node.begin;
+                    while (i < node.end && str(words_[i]).size() == node.depth) {
+                        i++;
+                    }
+                    nodes_[n].first_child = (uint32_t)nodes_.size();
+                    while (i < node.end) {
+                        char c = str(words_[i])[node.depth];
+                        uint32_t j = i;
+                        while (j < node.end && str(words_[j])[node.depth] == c) {
+                            j++;
+                        }
+                        nodes_.push_back(Node{0, 0, i, j, node.depth + 1, c});
+                        nodes_[n].children++;
+                        i = j;
+                    }
+                }
+            }
+            // Calls f(word, tag) for every word starting with prefix, in
+            // sorted order.
+            template <class F>
+            void find(std::string_view prefix, F f) const {
+                if (nodes_.empty()) {
+                    return;
+                }
+                const Node* node = &nodes_[0];
+                for (char c : prefix) {
+                    auto first = nodes_.begin() + node->first_child;
+                    auto last = first + node->children;
+                    auto it = std::lower_bound(first, last, c, [](const Node& n, char v) {
+                        return (unsigned char)n.c < (unsigned char)v;
+                    });
+                    if (it == last || it->c != c) {
+                        return;
+                    }
+                    node = &*it;
+                }
+                for (uint32_t i = node->begin; i < node->end; i++) {
+                    f(str(words_[i]), words_[i].tag);
+                }
+            }
+
+        private:
+            struct Word {
+                uint32_t offset;
+                uint32_t length;
+                uint8_t tag;
+            };
+            struct Node {
+                uint32_t first_child;
+                uint32_t children;
+                uint32_t begin;         // words under the node
+                uint32_t end;
+                uint32_t depth;
+                char c;
+            };
+            std::string_view str(const Word& w) const {
+                return std::string_view(text_).substr(w.offset, w.length);
+            }
+            std::pmr::string text_;
+            std::pmr::vector<Word> words_;
+            std::pmr::vector<Node> nodes_;
+        };
+
+        // Reads the next word of text from pos, split like a POSIX shell
+        // without expansions: blanks separate words, '...' is taken
+        // literally, "..." keeps blanks and unescapes \" \\ \$ \`, and a
+        // backslash elsewhere escapes the next character. A plain word is
+        // returned as a view into text, a quoted or escaped one is
+        // unescaped into storage.
+        inline bool next_word(std::string_view text, size_t& pos, std::string_view& word, std::string& storage) {
+            auto blank = [](char c) {
+                return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+            };
+            while (pos < text.size() && blank(text[pos])) {
+                pos++;
+            }
+            if (pos == text.size()) {
+                return false;
+            }
+            size_t begin = pos;
+            while (pos < text.size() && !blank(text[pos]) && text[pos] != '\'' && text[pos] != '"' && text[pos] != '\\') {
+                pos++;
+            }
+            if (pos == text.size() || blank(text[pos])) {
+                word = text.substr(begin, pos - begin);
+                return true;
+            }
+
+            storage.assign(text.substr(begin, pos - begin));
+            while (pos < text.size() && !blank(text[pos])) {
+                char c = text[pos++];
+                if (c == '\'') {
+                    size_t end = text.find('\'', pos);
+                    if (end == std::string_view::npos) {
+                        throw std::runtime_error("Unterminated quote.");
+                    }
+                    storage.append(text.substr(pos, end - pos));
+                    pos = end + 1;
+                } else if (c == '"') {
+                    for (;;) {
+                        if (pos == text.size()) {
+                            throw std::runtime_error("Unterminated quote.");
+                        }
+                        c = text[pos++];
+                        if (c == '"') {
+                            break;
+                        }
+                        if (c == '\\' && pos < text.size() && std::string_view("\"\\$`").find(text[pos]) != std::string_view::npos) {
+                            c = text[pos++];
+                        }
+                        storage.push_back(c);
+                    }
+                } else if (c == '\\') {
+                    if (pos < text.size()) {
+                        storage.push_back(text[pos++]);
+                    }
+                } else {
+                    storage.push_back(c);
+                }
+            }
+            word = storage;
+            return true;
+        }
+
+        // Splits one command line into words (see next_word). Words are
+        // written to buffer NUL-terminated and appended to argv.
+        inline void split_command_line(std::string_view line, std::string& buffer, std::string& storage, std::vector<const char*>& argv) {
+            // Unescaping never makes a word longer and every NUL replaces
+            // a blank or the end of the line, so the buffer does not
+            // reallocate and argv pointers stay valid.
+            buffer.clear();
+            buffer.reserve(line.size() + 1);
+            size_t pos = 0;
+            std::string_view word;
+            while (next_word(line, pos, word, storage)) {
+                argv.push_back(buffer.data() + buffer.size());
+                buffer.append(word);
+                buffer.push_back('\0');
+            }
+        }
+
+        // A whole file, read-only. It is memory-mapped where the platform
+        // allows it, so its text is not copied.
+        class mapped_file {
+        public:
+            explicit mapped_file(const char* path) {
+#if COMMAND_PARSER_MMAP
+                int fd = ::open(path, O_RDONLY);
+                struct stat st;
+                if (fd < 0 || ::fstat(fd, &st) != 0) {
+                    if (fd >= 0) {
+                        ::close(fd);
+                    }
+                    throw std::runtime_error("Cannot read response file \"" + std::string(path) + "\".");
+                }
+                size_ = st.st_size;
+                if (size_ > 0) {
+                    void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (p == MAP_FAILED) {
+                        ::close(fd);
+                        throw std::runtime_error("Cannot read response file \"" + std::string(path) + "\".");
+                    }
+                    ::madvise(p, size_, MADV_SEQUENTIAL);
+                    data_ = static_cast<const char*>(p);
+                }
+                ::close(fd);
+#else
+                std::ifstream in(path, std::ios::binary);
+                if (!in) {
+                    throw std::runtime_error("Cannot read response file \"" + std::string(path) + "\".");
+                }
+                text_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+#endif
+            }
+            mapped_file(mapped_file&& other) noexcept :
+                data_(other.data_),
+                size_(other.size_),
+                text_(std::move(other.text_))
+            {
+                other.data_ = nullptr;
+                other.size_ = 0;
+            }
+            mapped_file(const mapped_file&) = delete;
+            mapped_file& operator=(const mapped_file&) = delete;
+            ~mapped_file() {
+#if COMMAND_PARSER_MMAP
+                if (data_ != nullptr) {
+                    ::munmap(const_cast<char*>(data_), size_);
+                }
+#endif
+            }
+
+            std::string_view text() const {
+                return data_ != nullptr ? std::string_view(data_, size_) : std::string_view(text_.data(), text_.size());
+            }
+
+        private:
+            const char* data_ = nullptr;
+            size_t size_ = 0;
+            std::vector<char> text_;        // used where files cannot be mapped
+        };
+
+        // A "key = value" line of a config file.
+        struct ConfigEntry {
+            std::string_view key;
+            std::string_view value;
+        };
+
+        // Collects the entries of an INI-like text: blank lines, lines
+        // starting with '#' or ';' and [section] headers are skipped,
+        // blanks around keys and values and quotes around a value are
+        // removed. Entries point into text.
+        template <class Entries>
+        void parse_config(std::string_view text, Entries& entries, const std::string& path) {
+            auto trim = [](std::string_view v) {
+                size_t first = v.find_first_not_of(" \t\r");
+                if (first == std::string_view::npos) {
+                    return std::string_view();
+                }
+                return v.substr(first, v.find_last_not_of(" \t\r") - first + 1);
+            };
+            size_t number = 0;
+            for (size_t pos = 0; pos < text.size(); ) {
+                size_t end = std::min(text.find('\n', pos), text.size());
+                std::string_view line = trim(text.substr(pos, end - pos));
+                pos = end + 1;
+                number++;
+                if (line.empty() || line[0] == '#' || line[0] == ';' || line[0] == '[') {
+                    continue;
+                }
+                size_t eq = line.find('=');
+                if (eq == std::string_view::npos) {
+                    throw std::runtime_error("Line " + to_str(number) + " of config file \"" + path + "\" is not \"key = value\".");
+                }
+                std::string_view value = trim(line.substr(eq + 1));
+                if (value.size() >= 2 && (value[0] == '"' || value[0] == '\'') && value.back() == value[0]) {
+                    value = value.substr(1, value.size() - 2);
+                }
+                entries.push_back(ConfigEntry{trim(line.substr(0, eq)), value});
+            }
+        }
+
+        // What one parse found for an option.
+        struct OptionState {
+            explicit OptionState(std::pmr::memory_resource* resource) :
+                owned(resource),
+                values(resource),
+                typed(resource)
+            {
+            }
+            OptionState(OptionState&&) = default;
+
+            std::string_view text() const {
+                return is_view ? view : std::string_view(owned);
+            }
+
+            bool use = false;
+            bool given = false;     // a value was given, not the default
+            value_source source = value_source::default_value;
+            bool is_view = false;
+            std::string_view view;
+            std::pmr::string owned;
+            std::pmr::vector<std::string_view> values;  // elements of a list option
+            typed_value typed;      // std::vector<T> for a list option
+        };
+
+        // What one parse bound to a parameter.
+        struct ParameterState {
+            explicit ParameterState(std::pmr::memory_resource* resource) :
+                values(resource),
+                owned(resource),
+                owned_values(resource),
+                typed(resource)
+            {
+            }
+            // Views into owned_values stay valid when the state is moved,
+            // copies would not point into their own storage.
+            ParameterState(ParameterState&&) = default;
+
+            bool bound = false;
+            bool is_view = false;
+            std::string_view view;
+            std::pmr::vector<std::string_view> values;
+            std::pmr::string owned;
+            std::pmr::deque<std::pmr::string> owned_values;
+            typed_value typed;      // std::vector<T> for a variadic parameter
+        };
+
+        // Everything a parse changes. Options and parameters only hold
+        // the definition, so one rule can be parsed any number of times
+        // and by several threads at once.
+        struct ParseState {
+            ParseState(std::pmr::memory_resource* resource, size_t option_count, size_t param_count) :
+                options(resource),
+                params(resource),
+                files(resource),
+                words(resource)
+            {
+                options.reserve(option_count);
+                for (size_t i = 0; i < option_count; i++) {
+                    options.emplace_back(resource);
+                }
+                params.reserve(param_count);
+                for (size_t i = 0; i < param_count; i++) {
+                    params.emplace_back(resource);
+                }
+            }
+            ParseState(ParseState&&) = default;
+            ParseState(const ParseState&) = delete;
+
+            // Before the first parse every option and parameter is unused.
+            const OptionState& option(size_t index) const {
+                static const OptionState unparsed(std::pmr::get_default_resource());
+                return index < options.size() ? options[index] : unparsed;
+            }
+            const ParameterState& param(size_t index) const {
+                static const ParameterState unparsed(std::pmr::get_default_resource());
+                return index < params.size() ? params[index] : unparsed;
+            }
+
+            std::pmr::vector<OptionState> options;
+            std::pmr::vector<ParameterState> params;
+            size_t cursor = 0;      // next parameter to bind
+            bool help = false;
+            // Response files and their unescaped words, values may point
+            // into them.
+            std::pmr::deque<mapped_file> files;
+            std::pmr::deque<std::pmr::string> words;
+
+            // Set while a parse sampled for stats runs.
+#if COMMAND_PARSER_STATS
+            Probe* probe() const {
+                return probe_;
+            }
+            void set_probe(Probe* probe) {
+                probe_ = probe;
+            }
+            Probe* probe_ = nullptr;
+#else
+            Probe* probe() const {
+                return nullptr;
+            }
+            void set_probe(Probe*) { }
+#endif
+        };
+
+        // long name style is  "--long_name"
+        // short name style is "-short_name"
+        class Option {
+        public:
+            Option(std::pmr::memory_resource* resource, std::string_view lname, char sname, std::string_view message) :
+                lname_(lname, resource),
+                sname_(sname),
+                message_(message, resource),
+                value_(resource),
+                candidates_(resource),
+                default_typed_(resource)
+            {
+            }
+            Option(Option&&) = default;
+            Option& operator=(Option&&) = default;
+
+            bool has_value() const {
+                return has_value_;
+            }
+            template <class F>
+            void set_validator(F v) {
+                validator = user_validator(std::move(v), resource());
+            }
+            void set_validator(regex v) {
+                pattern_ = std::move(v);
+            }
+
+            // The given value, or the default one.
+            std::string_view value(const OptionState& s) const {
+                if(has_value_ == false) {
+                    throw std::logic_error("Don't has a value.");
+                }
+                if (list_) {
+                    throw std::logic_error("\"" + std::string(lname_) + "\" has multiple values.");
+                }
+                return s.given ? s.text() : std::string_view(value_);
+            }
+            // keep_view stores value itself instead of a copy, it has to
+            // outlive the state.
+            void set(OptionState& s, std::string_view value, bool keep_view = false) const {
+                if(has_value_ == false) {
+                    throw std::logic_error("Don't has a value.");
+                }
+                s.is_view = keep_view;
+                if (keep_view) {
+                    s.view = value;
+                } else {
+                    s.owned.assign(value);
+                }
+                s.given = true;
+                s.use = true;
+            }
+            std::string_view long_name() const {
+                return lname_;
+            }
+            char short_name() const {
+                return sname_;
+            }
+            std::string_view message() const {
+                return message_;
+            }
+            const CandidateSet& candidates() const {
+                return candidates_;
+            }
+            // The message with what the validators accept, built only
+            // when usage is shown.
+            void describe(std::string& out) const {
+                out += message_;
+                if (!candidates_.empty()) {
+                    out += " : Available pattern {";
+                    for (size_t i = 0; i < candidates_.size(); i++) {
+                        if (i != 0) {
+                            out += ", ";
+                        }
+                        out += candidates_[i];
+                    }
+                    out += "}";
+                }
+                if (describe_range_) {
+                    out += " : ";
+                    describe_range_(out);
+                }
+            }
+            template <class T>
+            void set_type() {
+                type_ = &value_type_of<T>();
+            }
+            const ValueType* type() const {
+                return type_;
+            }
+            template <class T>
+            void set_range(range<T> r) {
+                bounds_.assign(r);
+                in_range_ = RangeCheck([r](const void* v) {
+                    return r.contains(*static_cast<const T*>(v));
+                }, resource());
+                describe_range_ = Describe([r](std::string& out) {
+                    out += "range is [" + to_str(r.min()) + ", " + to_str(r.max()) + "]";
+                }, resource());
+            }
+            std::pmr::memory_resource* resource() const {
+                return lname_.resource();
+            }
+
+            // What rule::save_schema writes and a schema image sets again.
+            std::string_view default_value() const {
+                return value_;
+            }
+            bool has_range() const {
+                return (bool)in_range_;
+            }
+            const RangeBounds& range_bounds() const {
+                return bounds_;
+            }
+            const std::optional<regex>& pattern() const {
+                return pattern_;
+            }
+            char delimiter() const {
+                return delimiter_;
+            }
+            size_t reserve_hint() const {
+                return reserve_;
+            }
+            CandidateSet& candidates() {
+                return candidates_;
+            }
+            // Names, message and default that point into a schema image.
+            void borrow(std::string_view lname, std::string_view message, std::string_view value) {
+                lname_.borrow(lname);
+                message_.borrow(message);
+                value_.borrow(value);
+            }
+            void set_has_value(bool has_value) {
+                has_value_ = has_value;
+            }
+
+            // A list option keeps every value it is given, each split at
+            // delimiter unless that is '\0'. Without values it holds an
+            // empty std::vector<T>.
+            template <class T>
+            void set_list(char delimiter) {
+                list_ = true;
+                delimiter_ = delimiter;
+                default_typed_.emplace<std::vector<T>>();
+            }
+            bool is_list() const {
+                return list_;
+            }
+            void set_reserve(size_t n) {
+                reserve_ = n;
+            }
+            const std::pmr::vector<std::string_view>& values(const OptionState& s) const {
+                return s.values;
+            }
+            // Splits text and checks each element like check, appending it
+            // and its converted value to s. Stops at the first invalid
+            // element, which is left in bad. With keep_view false the
+            // caller keeps text alive, the elements are views into it.
+            parse_errc append(OptionState& s, std::string_view text, bool keep_view, std::string& detail, std::string_view& bad) const {
+                if (s.values.empty() && reserve_ != 0) {
+                    s.values.reserve(reserve_);
+                    if (type_ != nullptr && !(keep_view && type_->is_string)) {
+                        type_->reserve(s.typed, reserve_);
+                    }
+                }
+                s.use = true;
+                s.given = true;
+                s.is_view = keep_view;
+                if (text.empty()) {
+                    return parse_errc::none;
+                }
+                bool convert = type_ != nullptr && !(keep_view && type_->is_string);
+                for (size_t pos = 0; ; ) {
+                    size_t end = delimiter_ == '\0' ? text.size() : std::min(text.find(delimiter_, pos), text.size());
+                    std::string_view element = text.substr(pos, end - pos);
+                    parse_errc code = parse_errc::none;
+                    if (convert) {
+                        const void* v = type_->convert_append(element, s.typed, detail);
+                        if (v == nullptr) {
+                            code = parse_errc::invalid_value;
+                        } else if (in_range_ && !in_range_(v)) {
+                            code = parse_errc::out_of_range;
+                        }
+                    }
+                    if (code == parse_errc::none) {
+                        code = check_text(element);
+                    }
+                    if (code == parse_errc::none) {
+                        code = call_validator(validator, element, detail);
+                    }
+                    if (code != parse_errc::none) {
+                        bad = element;
+                        return code;
+                    }
+                    s.values.push_back(element);
+                    if (end == text.size()) {
+                        return parse_errc::none;
+                    }
+                    pos = end + 1;
+                }
+            }
+
+            // Converts raw into out and runs the validators without
+            // throwing. Returns what failed, detail gets the message of a
+            // converter or a user validator that threw. A string kept as
+            // a view is not copied into out.
+            parse_errc check(std::string_view raw, bool is_view, typed_value& out, std::string& detail) const {
+                parse_errc code = convert(raw, is_view, out, detail);
+                if (code == parse_errc::none) {
+                    code = check_value(raw, out);
+                }
+                return code == parse_errc::none ? call_validator(validator, raw, detail) : code;
+            }
+            // The steps of check: conversion, the checks of the schema,
+            // then the user validator.
+            parse_errc convert(std::string_view raw, bool is_view, typed_value& out, std::string& detail) const {
+                if (has_value_ && type_ != nullptr && !(is_view && type_->is_string) && !type_->convert(raw, out, detail)) {
+                    return parse_errc::invalid_value;
+                }
+                return parse_errc::none;
+            }
+            parse_errc check_value(std::string_view raw, const typed_value& out) const {
+                if (in_range_ && !out.empty() && !in_range_(out.data())) {
+                    return parse_errc::out_of_range;
+                }
+                return check_text(raw);
+            }
+            bool has_validator() const {
+                return (bool)validator;
+            }
+            parse_errc check_user(std::string_view raw, std::string& detail) const {
+                return call_validator(validator, raw, detail);
+            }
+            parse_errc check_text(std::string_view raw) const {
+                if (!candidates_.empty() && !candidates_.contains(raw)) {
+                    return parse_errc::not_candidate;
+                }
+                if (pattern_ && !pattern_->matches(raw)) {
+                    return parse_errc::no_match;
+                }
+                return parse_errc::none;
+            }
+
+            std::string error_message(parse_errc code, std::string_view value, const std::string& detail) const {
+                std::string id = "--" + std::string(lname_) + "(-" + std::string(1, sname_) + ")";
+                std::string mes = "\"" + id + "\" validation failed. ";
+                switch (code) {
+                case parse_errc::missing_value:
+                    return "Option \"" + std::string(value) + "\" need a value.";
+                case parse_errc::unexpected_value:
+                    return "Option " + std::string(lname_) + " does't need a value.";
+                case parse_errc::invalid_value:
+                    if (!has_value_) {
+                        return "\"--" + std::string(lname_) + "\" takes true or false, not \"" + std::string(value) + "\".";
+                    }
+                    return mes + (detail.empty() ? std::string(value) + type_->error : detail);
+                case parse_errc::not_candidate:
+                    return mes + id + " cannot specify the \"" + std::string(value) + "\"";
+                case parse_errc::no_match:
+                    return mes + std::string(value) + " does not match " + pattern_->pattern();
+                case parse_errc::out_of_range:
+                    mes += std::string(value) + " is out of range. ";
+                    describe_range_(mes);
+                    return mes;
+                default:
+                    return detail.empty() ? "Option validation failed. \"" + id + "\"" : mes + detail;
+                }
+            }
+
+            // Converted default, kept once it was checked.
+            const typed_value& default_typed() const {
+                return default_typed_;
+            }
+            void set_default_typed(typed_value v) {
+                default_typed_ = std::move(v);
+            }
+
+        protected:
+            Text lname_;
+            char sname_;
+            Text message_;
+            Validator validator;
+            bool has_value_ = false;
+            Text value_;
+            const ValueType* type_ = nullptr;
+            RangeCheck in_range_;
+            RangeBounds bounds_;
+            Describe describe_range_;
+            std::optional<regex> pattern_;
+            CandidateSet candidates_;
+            typed_value default_typed_;
+            bool list_ = false;
+            char delimiter_ = '\0';
+            size_t reserve_ = 0;
+        };
+
+        // long name style is  "--long_name=value"
+        // short name style is "-short_name value"
+        class ValueOption : public Option {
+        public:
+            template <class F = null_validator>
+            ValueOption(std::pmr::memory_resource* resource, std::string_view lname, char sname, std::string_view message, std::string_view def_val, F v = F()) :
+                Option(resource, lname, sname, message)
+            {
+                has_value_ = true;
+                value_ = def_val;
+                set_validator(std::move(v));
+            }
+
+            template <class T>
+            ValueOption(std::pmr::memory_resource* resource, std::string_view lname, char sname, std::string_view message, std::string_view def_val, range<T> r) :
+                Option(resource, lname, sname, message)
+            {
+                has_value_ = true;
+                value_ = def_val;
+                set_type<T>();
+                set_range(r);
+            }
+        };
+
+        // Derived option classes only configure the members of Option,
+        // so they can be stored by value as Option.
+        class WithCandidateValueOption : public ValueOption {
+        public:
+            template <class T>
+                WithCandidateValueOption(std::pmr::memory_resource* resource, std::string_view lname, char sname, std::string_view message, std::string_view def_val, std::vector<T> candidates) :
+                    ValueOption(resource, lname, sname, message, def_val)
+            {
+                for(auto v : candidates) {
+                    candidates_.add(detail::to_str(v));
+                }
+                candidates_.seal();
+            }
+        };
+
+
+        // Options live contiguously in registration order and are found by
+        // index: short names through a 256-entry table, long names through
+        // binary search over indexes sorted by name.
+        class OptionsInfo{
+        public:
+            static constexpr int npos = -1;
+
+            explicit OptionsInfo(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+                sorted_(resource),
+                lengths_(resource),
+                options_(resource)
+            {
+                short_index_.fill(npos);
+            }
+
+            Option& add(Option op) {
+                if(is_exist(op.short_name())) {
+                    throw std::logic_error("duplicated option");
+                }
+                if(is_exist(op.long_name())) {
+                    throw std::logic_error("duplicated option");
+                }
+                if(op.long_name().length() > (size_t)max_lname_length) {
+                    max_lname_length = op.long_name().length();
+                }
+                int index = options_.size();
+                short_index_[(unsigned char)op.short_name()] = index;
+                sorted_.insert(lower_bound(op.long_name()), index);
+                lengths_.insert(index, op.long_name().size());
+                options_.push_back(std::move(op));
+                return options_.back();
+            }
+            int get_max_length() const {
+                return max_lname_length;
+            }
+
+            int find(std::string_view long_name) const {
+                auto it = lower_bound(long_name);
+                if(it != sorted_.end() && options_[*it].long_name() == long_name) {
+                    return *it;
+                }
+                return npos;
+            }
+            int find(char short_name) const {
+                return short_index_[(unsigned char)short_name];
+            }
+            Option& at(int index) {
+                return options_[index];
+            }
+            const Option& at(int index) const {
+                return options_[index];
+            }
+
+            bool is_exist(std::string_view long_name) const {
+                return find(long_name) != npos;
+            }
+            bool is_exist(char short_name) const {
+                return find(short_name) != npos;
+            }
+            // Long names near a mistyped one, for error messages.
+            void suggest(Suggestions& s) const {
+                s.consider(lengths_, [this](uint32_t i) { return options_[i].long_name(); });
+            }
+            std::string did_you_mean(std::string_view long_name) const {
+                Suggestions s(long_name);
+                suggest(s);
+                std::string out;
+                append_suggestions(out, s.take());
+                return out;
+            }
+
+            bool is_use(const ParseState& state, const std::string& long_name) const {
+                int index = find(long_name);
+                if(index == npos) {
+                    throw std::logic_error("Undefined parameter." + did_you_mean(long_name));
+                }
+                return state.option(index).use;
+            }
+            bool has_value(const std::string& long_name) const {
+                int index = find(long_name);
+                if(index == npos) {
+                    throw std::runtime_error("Parameter invalid" + did_you_mean(long_name));
+                }
+                return options_[index].has_value();
+
+            }
+            bool has_value(char short_name) const {
+                int index = find(short_name);
+                if(index == npos) {
+                    throw std::runtime_error("Parameter invalid");
+                }
+                return options_[index].has_value();
+            }
+
+            template <class T>
+            T get_value(const ParseState& state, const std::string& long_name) const {
+                int index = defined(long_name);
+                const OptionState& s = state.option(index);
+                return typed_get<T>(options_[index].type(), typed(index, s), options_[index].value(s), long_name);
+            }
+
+            template <class T>
+            const T& get_ref(const ParseState& state, const std::string& long_name) const {
+                int index = defined(long_name);
+                const OptionState& s = state.option(index);
+                if (options_[index].is_list()) {
+                    return typed_ref<T>(nullptr, typed(index, s), long_name);
+                }
+                options_[index].value(s);
+                return typed_ref<T>(options_[index].type(), typed(index, s), long_name);
+            }
+
+            template <class T>
+            std::vector<T> get_values(const ParseState& state, const std::string& long_name) const {
+                int index = defined(long_name);
+                const Option& op = options_[index];
+                const OptionState& s = state.option(index);
+                if (!op.is_list()) {
+                    throw std::logic_error(long_name + " is not a list option.");
+                }
+                if (op.type() != nullptr && op.type()->id != type_id<T>()) {
+                    throw std::logic_error(long_name + " is not of the requested type.");
+                }
+                if (const std::vector<T>* v = typed(index, s).template get<std::vector<T>>(); v != nullptr && v->size() == s.values.size()) {
+                    return *v;
+                }
+                std::vector<T> ret;
+                ret.reserve(s.values.size());
+                for (const auto& v : s.values) {
+                    ret.push_back(convert_view<T>(v));
+                }
+                return ret;
+            }
+            const std::pmr::vector<std::string_view>& get_views(const ParseState& state, const std::string& long_name) const {
+                int index = defined(long_name);
+                return options_[index].values(state.option(index));
+            }
+
+            std::string_view get_view(const ParseState& state, const std::string& long_name) const {
+                int index = defined(long_name);
+                return options_[index].value(state.option(index));
+            }
+
+            value_source source(const ParseState& state, const std::string& long_name) const {
+                return state.option(defined(long_name)).source;
+            }
+
+            std::string_view to_long_name(char short_name) const {
+                int index = find(short_name);
+                if(index == npos) {
+                    throw std::runtime_error("Option name invalid");
+                }
+                return options_[index].long_name();
+            }
+
+            // Registration order.
+            auto begin() const { return options_.begin(); }
+            auto end() const { return options_.end(); }
+
+            // Indexes ordered by long name.
+            const std::pmr::vector<int>& sorted() const {
+                return sorted_;
+            }
+            const LengthIndex& lengths() const {
+                return lengths_;
+            }
+            // Options of a schema image with their orders as saved, so
+            // nothing is sorted again.
+            void restore(std::pmr::vector<Option> options, std::pmr::vector<int> sorted, std::pmr::vector<LengthIndex::Entry> lengths) {
+                options_ = std::move(options);
+                sorted_ = std::move(sorted);
+                lengths_.assign(std::move(lengths));
+                short_index_.fill(npos);
+                max_lname_length = 0;
+                for (size_t i = 0; i < options_.size(); i++) {
+                    short_index_[(unsigned char)options_[i].short_name()] = (int)i;
+                    max_lname_length = std::max(max_lname_length, (int)options_[i].long_name().size());
+                }
+            }
+
+            size_t size() const {
+                return options_.size();
+            }
+            bool empty() const {
+                return options_.empty();
+            }
+        private:
+            // A default that was not validated by the parse uses the one
+            // converted when the rule was built, if any.
+            const typed_value& typed(int index, const OptionState& s) const {
+                if (s.source == value_source::default_value && s.typed.empty()) {
+                    return options_[index].default_typed();
+                }
+                return s.typed;
+            }
+
+            int defined(const std::string& long_name) const {
+                int index = find(long_name);
+                if(index == npos) {
+                    throw std::logic_error(long_name + "is not defined." + did_you_mean(long_name));
+                }
+                return index;
+            }
+
+            std::pmr::vector<int>::const_iterator lower_bound(std::string_view long_name) const {
+                return std::lower_bound(sorted_.begin(), sorted_.end(), long_name,
+                        [this](int index, std::string_view name) {
+                            return options_[index].long_name() < name;
+                        });
+            }
+
+            int max_lname_length = 0;
+            std::array<int, 256> short_index_;
+            std::pmr::vector<int> sorted_;
+            LengthIndex lengths_;
+            std::pmr::vector<Option> options_;
+        };
+
+        class Parameter {
+        public:
+            Parameter(std::pmr::memory_resource* resource, int order, std::string_view name, std::string_view message) :
+                order_(order),
+                name_(name, resource),
+                message_(message, resource)
+            {
+            }
+            Parameter(Parameter&&) = default;
+            Parameter& operator=(Parameter&&) = default;
+
+            int get_order() const {
+                return order_;
+            }
+            template <class F>
+            void set_validator(F v) {
+                validator = user_validator(std::move(v), resource());
+            }
+            void set_validator(regex v) {
+                pattern_ = std::move(v);
+            }
+
+            // keep_view stores value itself instead of a copy, it has to
+            // outlive the state.
+            void set(ParameterState& s, std::string_view value, bool keep_view = false) const {
+                if (variadic_) {
+                    if (!keep_view) {
+                        s.owned_values.emplace_back(value);
+                        value = s.owned_values.back();
+                    }
+                    s.values.push_back(value);
+                } else if (keep_view) {
+                    s.view = value;
+                } else {
+                    s.owned.assign(value);
+                }
+                s.is_view = keep_view;
+                s.bound = true;
+            }
+
+            std::string_view value(const ParameterState& s) const {
+                if (variadic_) {
+                    throw std::logic_error("\"" + std::string(name_) + "\" has multiple values.");
+                }
+                return s.is_view ? s.view : std::string_view(s.owned);
+            }
+            const std::pmr::vector<std::string_view>& values(const ParameterState& s) const {
+                return s.values;
+            }
+
+            // A variadic parameter takes every remaining argument.
+            bool is_variadic() const {
+                return variadic_;
+            }
+            void set_variadic() {
+                variadic_ = true;
+            }
+
+            std::string_view name() const {
+                return name_;
+            }
+            std::string_view message() const {
+                return message_;
+            }
+            void describe(std::string& out) const {
+                out += message_;
+                if (describe_range_) {
+                    out += " : ";
+                    describe_range_(out);
+                }
+            }
+            template <class T>
+            void set_type() {
+                type_ = &value_type_of<T>();
+            }
+            const ValueType* type() const {
+                return type_;
+            }
+            template <class T>
+            void set_range(range<T> r) {
+                bounds_.assign(r);
+                in_range_ = RangeCheck([r](const void* v) {
+                    return r.contains(*static_cast<const T*>(v));
+                }, resource());
+                describe_range_ = Describe([r](std::string& out) {
+                    out += "range is [" + to_str(r.min()) + ", " + to_str(r.max()) + "]";
+                }, resource());
+            }
+            std::pmr::memory_resource* resource() const {
+                return name_.resource();
+            }
+
+            // Like the same members of Option.
+            bool has_range() const {
+                return (bool)in_range_;
+            }
+            const RangeBounds& range_bounds() const {
+                return bounds_;
+            }
+            const std::optional<regex>& pattern() const {
+                return pattern_;
+            }
+            int max_length() const {
+                return max_length_;
+            }
+            void set_max_length(int max_length) {
+                max_length_ = max_length;
+            }
+            void borrow(std::string_view name, std::string_view message) {
+                name_.borrow(name);
+                message_.borrow(message);
+            }
+
+            // Converts value into out and runs the validators without
+            // throwing, like Option::check.
+            parse_errc check(std::string_view value, bool is_view, typed_value& out, std::string& detail) const {
+                parse_errc code = convert(value, is_view, out, detail);
+                if (code == parse_errc::none) {
+                    code = check_value(value, out);
+                }
+                return code == parse_errc::none ? call_validator(validator, value, detail) : code;
+            }
+            parse_errc convert(std::string_view value, bool is_view, typed_value& out, std::string& detail) const {
+                if (type_ != nullptr && !(is_view && type_->is_string) && !type_->convert(value, out, detail)) {
+                    return parse_errc::invalid_value;
+                }
+                return parse_errc::none;
+            }
+            bool has_validator() const {
+                return (bool)validator;
+            }
+            parse_errc check_user(std::string_view value, std::string& detail) const {
+                return call_validator(validator, value, detail);
+            }
+            parse_errc check_value(std::string_view value, const typed_value& out) const {
+                if (max_length_ >= 0 && (size_t)max_length_ < value.length()) {
+                    return parse_errc::too_long;
+                }
+                if (pattern_ && !pattern_->matches(value)) {
+                    return parse_errc::no_match;
+                }
+                if (in_range_ && !out.empty() && !in_range_(out.data())) {
+                    return parse_errc::out_of_range;
+                }
+                return parse_errc::none;
+            }
+
+            std::string error_message(parse_errc code, std::string_view value, const std::string& detail) const {
+                std::string mes = "\"" + std::string(name_) + "\" validation failed. ";
+                switch (code) {
+                case parse_errc::missing_argument:
+                    return "The " + to_str(order_) + "(" + std::string(name_) + ") argument is not specified.";
+                case parse_errc::invalid_value:
+                    return mes + (detail.empty() ? std::string(value) + type_->error : detail);
+                case parse_errc::too_long:
+                    return mes + "Over-length error. Max length of \"" + std::string(name_) + "\" is " + to_str(max_length_) + ".";
+                case parse_errc::no_match:
+                    return mes + std::string(value) + " does not match " + pattern_->pattern();
+                case parse_errc::out_of_range:
+                    mes += std::string(value) + " is out of range. ";
+                    describe_range_(mes);
+                    return mes;
+                default:
+                    return detail.empty() ? "Argument validation failed. \"" + std::string(name_) + "\"" : mes + detail;
+                }
+            }
+            // Keeps a checked value, appended to the list for a variadic
+            // parameter.
+            void store(ParameterState& s, typed_value& v) const {
+                if (!variadic_) {
+                    s.typed = std::move(v);
+                } else if (!v.empty()) {
+                    type_->append(v, s.typed);
+                }
+            }
+
+        protected:
+            int order_;
+            Text name_;
+            Text message_;
+            Validator validator;
+            bool variadic_ = false;
+            const ValueType* type_ = nullptr;
+            RangeCheck in_range_;
+            RangeBounds bounds_;
+            Describe describe_range_;
+            int max_length_ = -1;
+            std::optional<regex> pattern_;
+        };
+
+        // Like the option classes, derived parameter classes only
+        // configure the members of Parameter and are stored as Parameter.
+        template <class T>
+        class RangeParameter : public Parameter {
+        public:
+            RangeParameter(std::pmr::memory_resource* resource, int order, std::string_view name, std::string_view message, range<T> r) :
+                Parameter(resource, order, name, message)
+            {
+                set_type<T>();
+                set_range(r);
+            }
+        };
+        class StringParameter : public Parameter {
+        public:
+            template <class F = null_validator>
+            StringParameter(std::pmr::memory_resource* resource, int order, std::string_view name, std::string_view message, int max_length, F v = F()) :
+                Parameter(resource, order, name, message)
+            {
+                set_validator(std::move(v));
+                set_type<std::string>();
+                max_length_ = max_length;
+            }
+        };
+
+        class ParametersInfo{
+        public:
+            explicit ParametersInfo(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+                order_map_(resource),
+                params_(resource)
+            {
+            }
+
+            void add(Parameter p) {
+                if(order_map_.count(p.name()) != 0) {
+                    throw std::logic_error("duplicated option");
+                }
+                if(!params_.empty() && params_.back().is_variadic()) {
+                    throw std::logic_error("variadic parameter must be the last one");
+                }
+                order_map_.emplace(p.name(), params_.size());
+                params_.push_back(std::move(p));
+            }
+
+            static constexpr size_t npos = size_t(-1);
+
+            // Binds value to the first unbound parameter. Parameters are
+            // bound in order, so this is the one under the cursor. npos
+            // when all are bound.
+            size_t set(ParseState& state, std::string_view value, bool keep_view = false) const {
+                if (state.cursor == params_.size()) {
+                    return npos;
+                }
+                size_t index = state.cursor;
+                const Parameter& p = params_[index];
+                p.set(state.params[index], value, keep_view);
+                if (!p.is_variadic()) {
+                    state.cursor++;
+                }
+                return index;
+            }
+
+            // At most n values can be bound to a trailing variadic parameter.
+            void reserve(ParseState& state, size_t n) const {
+                if (!params_.empty() && params_.back().is_variadic()) {
+                    state.params.back().values.reserve(n);
+                }
+            }
+
+            size_t size() const {
+                return params_.size();
+            }
+            const Parameter& at(size_t index) const {
+                return params_[index];
+            }
+            Parameter& back() {
+                return params_.back();
+            }
+
+            bool is_exist(std::string_view name) const {
+                return order_map_.count(name) == 1;
+            }
+
+            template <class T>
+            T get_value(const ParseState& state, const std::string& param) const {
+                size_t index = get(param);
+                const Parameter& p = params_[index];
+                const ParameterState& s = state.param(index);
+                return typed_get<T>(p.type(), s.typed, p.value(s), param);
+            }
+
+            template <class T>
+            const T& get_ref(const ParseState& state, const std::string& param) const {
+                size_t index = get(param);
+                const Parameter& p = params_[index];
+                const ParameterState& s = state.param(index);
+                if (p.is_variadic()) {
+                    return typed_ref<T>(nullptr, s.typed, param);
+                }
+                return typed_ref<T>(p.type(), s.typed, param);
+            }
+
+            template <class T>
+            std::vector<T> get_values(const ParseState& state, const std::string& param) const {
+                size_t index = get(param);
+                const Parameter& p = params_[index];
+                const ParameterState& s = state.param(index);
+                if (p.type() != nullptr && p.type()->id != type_id<T>()) {
+                    throw std::logic_error(param + " is not of the requested type.");
+                }
+                if (const std::vector<T>* v = s.typed.get<std::vector<T>>()) {
+                    return *v;
+                }
+                const std::pmr::vector<std::string_view>& values = p.values(s);
+                std::vector<T> ret;
+                ret.reserve(values.size());
+                for (const auto& v : values) {
+                    ret.push_back(convert_view<T>(v));
+                }
+                return ret;
+            }
+
+            std::string_view get_view(const ParseState& state, const std::string& param) const {
+                size_t index = get(param);
+                return params_[index].value(state.param(index));
+            }
+            const std::pmr::vector<std::string_view>& get_views(const ParseState& state, const std::string& param) const {
+                size_t index = get(param);
+                return params_[index].values(state.param(index));
+            }
+
+            auto begin() const { return params_.begin(); }
+            auto end() const { return params_.end(); }
+        private:
+            size_t get(const std::string& param) const {
+                auto it = order_map_.find(std::string_view(param));
+                if(it == order_map_.end()) {
+                    throw std::logic_error(param + "is not defined.");
+                }
+                return it->second;
+            }
+
+            std::pmr::map<std::pmr::string, size_t, std::less<>> order_map_;
+            std::pmr::vector<Parameter> params_;
+        };
+
+
+        // Values that passed validation for each option and parameter with
+        // their converted value, shared by all parses of a rule. A slot is
+        // emptied when it gets full.
+        class ValidationCache {
+        public:
+            static constexpr size_t max_entries = 256;
+
+            explicit ValidationCache(std::pmr::memory_resource* resource) :
+                options_(resource),
+                params_(resource)
+            {
+            }
+
+            bool find_option(size_t index, std::string_view raw, typed_value& out) const {
+                return find(options_, index, raw, out);
+            }
+            void store_option(size_t index, std::string_view raw, const typed_value& typed) {
+                store(options_, index, raw, typed);
+            }
+            bool find_param(size_t index, std::string_view raw, typed_value& out) const {
+                return find(params_, index, raw, out);
+            }
+            void store_param(size_t index, std::string_view raw, const typed_value& typed) {
+                store(params_, index, raw, typed);
+            }
+
+        private:
+            using Slot = std::pmr::map<std::pmr::string, typed_value, std::less<>>;
+            using Slots = std::pmr::vector<Slot>;
+
+            bool find(const Slots& slots, size_t index, std::string_view raw, typed_value& out) const {
+                std::shared_lock<std::shared_mutex> lock(mutex_);
+                if (index >= slots.size()) {
+                    return false;
+                }
+                auto it = slots[index].find(raw);
+                if (it == slots[index].end()) {
+                    return false;
+                }
+                out = it->second;
+                return true;
+            }
+            void store(Slots& slots, size_t index, std::string_view raw, const typed_value& typed) {
+                std::unique_lock<std::shared_mutex> lock(mutex_);
+                std::pmr::memory_resource* resource = slots.get_allocator().resource();
+                while (slots.size() <= index) {
+                    slots.emplace_back();
+                }
+                Slot& slot = slots[index];
+                if (slot.size() >= max_entries) {
+                    slot.clear();
+                }
+                auto it = slot.find(raw);
+                if (it == slot.end()) {
+                    it = slot.emplace(std::pmr::string(raw, resource), typed_value(resource)).first;
+                }
+                it->second = typed;
+            }
+
+            mutable std::shared_mutex mutex_;
+            Slots options_;
+            Slots params_;
+        };
+
+        // Destroys and frees an object allocated from a memory resource.
+        struct ResourceDelete {
+            std::pmr::memory_resource* resource;
+            template <class T>
+            void operator()(T* p) const {
+                p->~T();
+                resource->deallocate(p, sizeof(T), alignof(T));
+            }
+        };
+
+#if COMMAND_PARSER_STATS
+        // Counts what a sampled result allocates and passes it on.
+        class CountingResource : public std::pmr::memory_resource {
+        public:
+            explicit CountingResource(std::pmr::memory_resource* upstream) : upstream_(upstream) { }
+
+            std::pmr::memory_resource* upstream() const {
+                return upstream_;
+            }
+
+            size_t allocations = 0;
+            size_t bytes = 0;
+
+        private:
+            void* do_allocate(size_t bytes, size_t alignment) override {
+                void* p = upstream_->allocate(bytes, alignment);
+                allocations++;
+                this->bytes += bytes;
+                return p;
+            }
+            void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+                upstream_->deallocate(p, bytes, alignment);
+            }
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+                return this == &other;
+            }
+
+            std::pmr::memory_resource* upstream_;
+        };
+
+        // Observer of rule::set_stats_observer and which parses it sees.
+        struct StatsSink {
+            StatsSink(pmr_function<void(const parse_stats&)> observer, unsigned every) :
+                observer(std::move(observer)),
+                every(std::max(every, 1u))
+            {
+            }
+            // true for one parse in every, shared by all threads.
+            bool sample() {
+                return count.fetch_add(1, std::memory_order_relaxed) % every == 0;
+            }
+
+            pmr_function<void(const parse_stats&)> observer;
+            unsigned every;
+            std::atomic<unsigned> count{0};
+        };
+#endif
+
+        // Usage text of a rule, rendered once for a program name and width.
+        struct HelpCache {
+            explicit HelpCache(std::pmr::memory_resource* resource) :
+                program(resource),
+                text(resource)
+            {
+            }
+            std::mutex mutex;
+            bool valid = false;
+            size_t width = 0;
+            std::pmr::string program;
+            std::pmr::string text;
+        };
+
+        // What a word of the completion trie of a rule is.
+        enum class Completion : uint8_t {
+            option,     // "--name", or "--name=" when it takes a value
+            value,      // "--name=candidate"
+            command,
+        };
+
+        // Completion trie of a rule, built when first asked for.
+        struct CompletionCache {
+            explicit CompletionCache(std::pmr::memory_resource* resource) : trie(resource) { }
+            std::mutex mutex;
+            bool valid = false;
+            PrefixTrie trie;
+        };
+
+        // A schema image starts with the magic, whose last byte is the
+        // version, then the byte order mark, the size of the image and the
+        // offset of the record of the top rule.
+        constexpr char schema_magic[8] = {'c', 'm', 'd', 'p', 's', 'r', '\0', '\1'};
+        constexpr uint32_t schema_byte_order = 0x01020304;
+        constexpr uint32_t schema_header_size = 20;
+
+        // Fields of the option, parameter and subcommand records, a text
+        // takes two.
+        constexpr uint32_t schema_option_fields = 27;
+        constexpr uint32_t schema_parameter_fields = 19;
+        constexpr uint32_t schema_command_fields = 5;
+        constexpr uint32_t schema_has_value = 1;
+        constexpr uint32_t schema_list = 2;
+        constexpr uint32_t schema_range = 4;
+        constexpr uint32_t schema_pattern = 8;
+        constexpr uint32_t schema_variadic = 16;
+
+        // Writes a schema image. Every field is a native uint32_t, text is
+        // written once and referred to by (offset, length) from the start
+        // of the image, so the image holds no pointers.
+        class SchemaWriter {
+        public:
+            struct Str {
+                uint32_t at;
+                uint32_t size;
+            };
+
+            uint32_t size() const {
+                return (uint32_t)out.size();
+            }
+            void u32(uint32_t v) {
+                out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+            }
+            void str(Str s) {
+                u32(s.at);
+                u32(s.size);
+            }
+            void bytes(const void* p, size_t n) {
+                out.append(static_cast<const char*>(p), n);
+            }
+            Str text(std::string_view s) {
+                Str at{size(), (uint32_t)s.size()};
+                out.append(s);
+                return at;
+            }
+            template <class Pairs>
+            uint32_t pairs(const Pairs& v) {
+                uint32_t at = size();
+                for (const auto& p : v) {
+                    u32(p.first);
+                    u32(p.second);
+                }
+                return at;
+            }
+            void set(uint32_t at, uint32_t v) {
+                std::memcpy(&out[at], &v, sizeof(v));
+            }
+
+            std::string out;
+        };
+
+        // Reads the fields of a schema image at any alignment. Everything
+        // read is checked against the size of the image.
+        class SchemaReader {
+        public:
+            explicit SchemaReader(std::string_view image) : image_(image) { }
+
+            void check(uint64_t at, uint64_t size) const {
+                if (at + size > image_.size()) {
+                    throw std::runtime_error("Invalid schema image.");
+                }
+            }
+            uint32_t u32(uint32_t at) const {
+                check(at, sizeof(uint32_t));
+                uint32_t v;
+                std::memcpy(&v, image_.data() + at, sizeof(v));
+                return v;
+            }
+            std::string_view text(uint32_t at, uint32_t size) const {
+                check(at, size);
+                return image_.substr(at, size);
+            }
+            // count pairs at at, each of them accepted by valid.
+            template <class F>
+            std::pmr::vector<std::pair<uint32_t, uint32_t>> pairs(uint32_t at, uint32_t count, F valid, std::pmr::memory_resource* resource) const {
+                check(at, uint64_t(count) * 8);
+                std::pmr::vector<std::pair<uint32_t, uint32_t>> v(count, resource);
+                for (uint32_t i = 0; i < count; i++) {
+                    v[i].first = u32(at + 8 * i);
+                    v[i].second = u32(at + 8 * i + 4);
+                    if (!valid(v[i])) {
+                        throw std::runtime_error("Invalid schema image.");
+                    }
+                }
+                return v;
+            }
+            std::pmr::vector<int> indexes(uint32_t at, uint32_t count, uint32_t limit, std::pmr::memory_resource* resource) const {
+                check(at, uint64_t(count) * 4);
+                std::pmr::vector<int> v(count, resource);
+                for (uint32_t i = 0; i < count; i++) {
+                    uint32_t index = u32(at + 4 * i);
+                    if (index >= limit) {
+                        throw std::runtime_error("Invalid schema image.");
+                    }
+                    v[i] = (int)index;
+                }
+                return v;
+            }
+            std::string_view image() const {
+                return image_;
+            }
+
+        private:
+            std::string_view image_;
+        };
+
+        // The fields of one record, read in order.
+        struct SchemaFields {
+            const SchemaReader& in;
+            uint32_t at;
+
+            uint32_t next() {
+                uint32_t v = in.u32(at);
+                at += sizeof(uint32_t);
+                return v;
+            }
+            std::string_view text() {
+                uint32_t offset = next();
+                uint32_t size = next();
+                return in.text(offset, size);
+            }
+            void bytes(void* out, size_t n) {
+                std::memcpy(out, in.text(at, (uint32_t)n).data(), n);
+                at += (uint32_t)n;
+            }
+        };
+
+        // Columns of the terminal, COLUMNS first. 0 when stdout is not a
+        // terminal, so help written to pipes and logs is not wrapped.
+        inline size_t terminal_width() {
+            if (const char* columns = std::getenv("COLUMNS")) {
+                convert_result<size_t> w = try_convert<size_t>(columns);
+                if (w) {
+                    return w.value;
+                }
+            }
+#if COMMAND_PARSER_MMAP
+            struct winsize ws;
+            if (isatty(STDOUT_FILENO) && ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0) {
+                return ws.ws_col;
+            }
+#endif
+            return 0;
+        }
+
+        // Column reached by the last line of text, tab stops every 8.
+        inline size_t column_of(std::string_view text) {
+            size_t column = 0;
+            for (char c : text.substr(text.rfind('\n') + 1)) {
+                column = c == '\t' ? (column / 8 + 1) * 8 : column + 1;
+            }
+            return column;
+        }
+
+        // Appends text starting at column, broken at spaces so no line
+        // passes width. Continuation lines are indented to column. Nothing
+        // is wrapped with width 0 or when less than 20 columns are left.
+        inline void append_wrapped(std::pmr::string& out, std::string_view text, size_t column, size_t width) {
+            if (width == 0 || column + 20 > width || column + text.size() <= width) {
+                out += text;
+                return;
+            }
+            size_t room = width - column;
+            for (bool first = true; !text.empty(); first = false) {
+                if (!first) {
+                    out += '\n';
+                    out.append(column, ' ');
+                }
+                if (text.size() <= room) {
+                    out += text;
+                    break;
+                }
+                size_t cut = text.rfind(' ', room);
+                if (cut == std::string_view::npos || cut == 0) {
+                    cut = room;
+                }
+                out += text.substr(0, cut);
+                text.remove_prefix(cut);
+                text.remove_prefix(std::min(text.find_first_not_of(' '), text.size()));
+            }
+        }
+
+        // An option or a positional argument produced by parser::next.
+        struct Argument {
+            bool is_option;
+            int index;          // index in OptionsInfo, options only
+            int scope;          // levels above the innermost scope, options only
+            int position;       // index in argv
+            std::string_view value;     // points into argv or a response file
+        };
+
+        // Streams argv once. Every element is classified exactly once and
+        // the value of a short option is consumed together with it, so the
+        // caller can bind and validate each Argument as it arrives.
+        // "-xvf file" gives one Argument per letter, "-j8" attaches the
+        // value. After "--" every element is an argument, and so is "-".
+        // With a state, "@path" elements are replaced by the words of the
+        // file at path, which are read one at a time from the mapping and
+        // kept in the state.
+        class parser {
+        public:
+            static constexpr int max_depth = 16;
+
+            parser(int argc, char const* argv[], const detail::OptionsInfo& info, ParseState* response_files = nullptr) : 
+                argc_(argc),
+                argv_(argv),
+                scopes_{&info},
+                state_(response_files)
+            {
+            }
+
+            // Options of a selected subcommand. Names are looked up from
+            // the innermost scope out, so the options of the enclosing
+            // commands can still be given.
+            void push(const detail::OptionsInfo& info) {
+                if (depth_ == max_depth) {
+                    throw std::logic_error("Subcommands are nested too deep.");
+                }
+                scopes_[depth_++] = &info;
+            }
+            int size() const {
+                return argc_;
+            }
+#if COMMAND_PARSER_STATS
+            // argv elements and response file words read so far.
+            size_t tokens() const {
+                return tokens_;
+            }
+#endif
+
+            // false at the end of argv, or with error set when an element
+            // is malformed.
+            bool next(Argument& out, parse_error& error) {
+                out.value = std::string_view();
+                if (!cluster_.empty()) {
+                    out.position = cluster_position_;
+                    return next_short(out, error);
+                }
+                std::string_view arg;
+                for (;;) {
+                    if (!next_arg(arg, error)) {
+                        return false;
+                    }
+                    if (options_ended_ || arg != "--") {
+                        break;
+                    }
+                    options_ended_ = true;
+                }
+                Token t = options_ended_ ? Token{ OptionType::NOT_OP, std::string_view(), arg } : classify(arg);
+                out.position = position_;
+
+                // "-12" and other clusters whose first letter is no option
+                // are arguments.
+                if (t.type == OptionType::SHORT && t.name.size() > 1 && !find(t.name[0], out)) {
+                    t = Token{ OptionType::NOT_OP, std::string_view(), arg };
+                }
+
+                if (t.type == OptionType::NOT_OP) {
+                    out.is_option = false;
+                    out.index = OptionsInfo::npos;
+                    out.scope = 0;
+                    out.value = t.value;
+                    return true;
+                }
+
+                out.is_option = true;
+                if (t.type == OptionType::LONG) {
+                    if (!find(t.name, out)) {
+                        return unknown(error, out, t.name, arg);
+                    }
+                    if(option(out).has_value() == true) {
+                        return fail(error, parse_errc::missing_value, out, &option(out), arg);
+                    }
+                } else if (t.type == OptionType::LONG_WITH_VAL) {
+                    if (!find(t.name, out)) {
+                        return unknown(error, out, t.name, arg);
+                    }
+                    if(option(out).has_value() == false) {
+                        return fail(error, parse_errc::unexpected_value, out, &option(out), arg);
+                    }
+                    out.value = t.value;
+                } else if (t.type == OptionType::SHORT) {
+                    element_ = arg;
+                    cluster_ = t.name;
+                    cluster_position_ = position_;
+                    return next_short(out, error);
+                } else {
+                    return fail(error, parse_errc::malformed, out, nullptr, arg);
+                }
+                return true;
+            }
+
+            // An element could not be read, the rest of argv is not parsed.
+            bool failed() const {
+                return failed_;
+            }
+            bool fail(parse_error& error, parse_errc code, const Argument& arg, const Option* op, std::string_view value) {
+                error.set(code, arg.position, op, nullptr, value);
+                failed_ = true;
+                return false;
+            }
+
+        private:
+            // An unknown long name, with the names of every scope near it.
+            bool unknown(parse_error& error, const Argument& arg, std::string_view name, std::string_view value) {
+                fail(error, parse_errc::unknown_option, arg, nullptr, value);
+                Suggestions s(name);
+                for (int i = 0; i < depth_; i++) {
+                    scopes_[i]->suggest(s);
+                }
+                error.suggestions_ = s.take("--");
+                return false;
+            }
+
+            // The next letter of a short option cluster. The first option
+            // with a value takes the rest of the cluster, or the next
+            // element when nothing is left.
+            bool next_short(Argument& out, parse_error& error) {
+                char c = cluster_[0];
+                cluster_.remove_prefix(1);
+                out.is_option = true;
+                if (!find(c, out)) {
+                    cluster_ = std::string_view();
+                    return fail(error, parse_errc::unknown_option, out, nullptr, element_);
+                }
+                if (!option(out).has_value()) {
+                    return true;
+                }
+                if (!cluster_.empty()) {
+                    out.value = cluster_;
+                    cluster_ = std::string_view();
+                    return true;
+                }
+                if (!next_arg(out.value, error)) {
+                    return error ? false : fail(error, parse_errc::missing_value, out, &option(out), element_);
+                }
+                out.position = position_;
+                return true;
+            }
+
+            bool find(std::string_view long_name, Argument& out) const {
+                for (out.scope = 0; out.scope < depth_; out.scope++) {
+                    out.index = scopes_[depth_ - 1 - out.scope]->find(long_name);
+                    if (out.index != OptionsInfo::npos) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            bool find(char short_name, Argument& out) const {
+                for (out.scope = 0; out.scope < depth_; out.scope++) {
+                    out.index = scopes_[depth_ - 1 - out.scope]->find(short_name);
+                    if (out.index != OptionsInfo::npos) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            const Option& option(const Argument& arg) const {
+                return scopes_[depth_ - 1 - arg.scope]->at(arg.index);
+            }
+
+            // Next element of argv, or next word of the open response file.
+            // Words inside a response file are not expanded again.
+            bool next_arg(std::string_view& out, parse_error& error) {
+                for (;;) {
+                    if (file_ != nullptr) {
+                        bool found;
+                        try {
+                            found = next_word(file_->text(), file_pos_, out, storage_);
+                        } catch (std::runtime_error& e) {
+                            error.set(parse_errc::response_file, position_, nullptr, nullptr, argv_[position_], e.what());
+                            failed_ = true;
+                            return false;
+                        }
+                        if (found) {
+                            if (out.data() == storage_.data()) {
+                                out = state_->words.emplace_back(storage_);
+                            }
+#if COMMAND_PARSER_STATS
+                            tokens_++;
+#endif
+                            return true;
+                        }
+                        file_ = nullptr;
+                    }
+                    if (id_ >= argc_) {
+                        return false;
+                    }
+                    position_ = id_;
+                    const char* arg = argv_[id_++];
+                    if (state_ != nullptr && !options_ended_ && arg[0] == '@' && arg[1] != '\0') {
+                        try {
+                            file_ = &state_->files.emplace_back(arg + 1);
+                        } catch (std::runtime_error& e) {
+                            error.set(parse_errc::response_file, position_, nullptr, nullptr, arg, e.what());
+                            failed_ = true;
+                            return false;
+                        }
+                        file_pos_ = 0;
+                        continue;
+                    }
+                    out = arg;
+#if COMMAND_PARSER_STATS
+                    tokens_++;
+#endif
+                    return true;
+                }
+            }
+
+            int argc_;
+            char const** argv_;
+            std::array<const detail::OptionsInfo*, max_depth> scopes_;
+            int depth_ = 1;
+            ParseState* state_;
+            int position_ = 0;
+            bool failed_ = false;
+            bool options_ended_ = false;
+
+            // Letters of the current short option cluster not yet returned.
+            std::string_view element_;
+            std::string_view cluster_;
+            int cluster_position_ = 0;
+
+            int id_ = 1;
+            const mapped_file* file_ = nullptr;
+            size_t file_pos_ = 0;
+            std::string storage_;
+#if COMMAND_PARSER_STATS
+            size_t tokens_ = 0;
+#endif
+        };
+    };  // namespace detail
+
+    inline std::string_view parse_error::id() const {
+        if (option_ != nullptr) {
+            return option_->long_name();
+        }
+        if (param_ != nullptr) {
+            return param_->name();
+        }
+        return std::string_view();
+    }
+
+    inline std::string parse_error::message() const {
+        std::string text = base_message();
+        detail::append_suggestions(text, suggestions());
+        return text;
+    }
+
+    inline std::vector<std::string> parse_error::suggestions() const {
+        if (code_ == parse_errc::not_candidate && option_ != nullptr) {
+            detail::Suggestions s(value_);
+            option_->candidates().suggest(s);
+            return s.take();
+        }
+        return suggestions_;
+    }
+
+    inline std::string parse_error::base_message() const {
+        if (option_ != nullptr) {
+            return option_->error_message(code_, value_, detail_);
+        }
+        if (param_ != nullptr) {
+            return param_->error_message(code_, value_, detail_);
+        }
+        switch (code_) {
+        case parse_errc::none:
+            return std::string();
+        case parse_errc::unknown_option:
+            return value_.compare(0, 2, "--") == 0 ? "Parameter invalid" : "Option name invalid";
+        case parse_errc::too_many_arguments:
+            return "Parameter invalid";
+        case parse_errc::unknown_command:
+            return "Unknown command \"" + value_ + "\".";
+        case parse_errc::no_command:
+            return "No command is given.";
+        case parse_errc::response_file:
+            return detail_;
+        default:
+            return "command invalid";
+        }
+    }
+
+    // How rule keeps the text of given options and arguments.
+    //   owned : copies, argv may change after parse().
+    //   view  : string_views into argv, nothing is copied. argv has to
+    //           outlive the rule and must not be modified.
+    enum class argument_storage {
+        owned,
+        view,
+    };
+
+    // Values found by rule::parse_args. The rule is only read, it has to
+    // outlive the result and must not get new options or parameters
+    // meanwhile.
+    class parse_result {
+    public:
+        // The help option was given. Arguments after it were not parsed.
+        bool help() const {
+            return state_.help;
+        }
+
+        bool is_option_use(const std::string& name) const {
+            return options_->is_use(state_, name);
+        }
+        template <class T>
+        T get_option_value(const std::string& option_name) const {
+            return options_->get_value<T>(state_, option_name);
+        }
+        template <class T>
+        T get_param_value(const std::string& param_name) const {
+            return params_->get_value<T>(state_, param_name);
+        }
+        template <class T>
+        std::vector<T> get_param_values(const std::string& param_name) const {
+            return params_->get_values<T>(state_, param_name);
+        }
+        template <class T>
+        const T& get_option_ref(const std::string& option_name) const {
+            return options_->get_ref<T>(state_, option_name);
+        }
+        template <class T>
+        const T& get_param_ref(const std::string& param_name) const {
+            return params_->get_ref<T>(state_, param_name);
+        }
+        std::string_view get_option_view(const std::string& option_name) const {
+            return options_->get_view(state_, option_name);
+        }
+        std::string_view get_param_view(const std::string& param_name) const {
+            return params_->get_view(state_, param_name);
+        }
+        const std::pmr::vector<std::string_view>& get_param_views(const std::string& param_name) const {
+            return params_->get_views(state_, param_name);
+        }
+        value_source get_option_source(const std::string& option_name) const {
+            return options_->source(state_, option_name);
+        }
+        template <class T>
+        std::vector<T> get_option_values(const std::string& option_name) const {
+            return options_->get_values<T>(state_, option_name);
+        }
+        const std::pmr::vector<std::string_view>& get_option_views(const std::string& option_name) const {
+            return options_->get_views(state_, option_name);
+        }
+
+        // Name of the selected subcommand, empty when none was given.
+        std::string_view get_command() const {
+            return command_;
+        }
+        // Values of the selected subcommand. Options of this level given
+        // after the subcommand name are found here, not there.
+        const parse_result& get_subcommand() const {
+            if (!sub_) {
+                throw std::logic_error("No subcommand was selected.");
+            }
+            return *sub_;
+        }
+
+    private:
+        friend class rule;
+        parse_result(const detail::OptionsInfo& options, const detail::ParametersInfo& params, std::pmr::memory_resource* resource) :
+            options_(&options),
+            params_(&params),
+            state_(resource, options.size(), params.size()),
+            sub_(nullptr, detail::ResourceDelete{resource})
+        {
+        }
+#if COMMAND_PARSER_STATS
+        // A sampled result, allocated through counter.
+        using Counter = std::unique_ptr<detail::CountingResource, detail::ResourceDelete>;
+        parse_result(const detail::OptionsInfo& options, const detail::ParametersInfo& params, Counter counter) :
+            counter_(std::move(counter)),
+            options_(&options),
+            params_(&params),
+            state_(counter_.get(), options.size(), params.size()),
+            sub_(nullptr, detail::ResourceDelete{counter_.get()})
+        {
+        }
+
+        Counter counter_{nullptr, detail::ResourceDelete{nullptr}};
+#endif
+        const detail::OptionsInfo* options_;
+        const detail::ParametersInfo* params_;
+        detail::ParseState state_;
+        std::string_view command_;
+        std::unique_ptr<parse_result, detail::ResourceDelete> sub_;
+    };
+
+    // When rule validates values.
+    //   eager : every parse validates the given values and all defaults.
+    //   lazy  : a default is validated once when it is added, and a value
+    //           that passed is remembered, so giving it again in a later
+    //           parse does not run the validators. They have to give the
+    //           same answer for the same string.
+    enum class validation {
+        eager,
+        lazy,
+    };
+
+    // Shells that rule::completion_script writes for.
+    enum class shell {
+        bash,
+        zsh,
+        fish,
+    };
+
+    // One command line of rule::parse_batch.
+    struct batch_entry {
+        size_t line;                            // 1-based line number
+        std::optional<parse_result> result;     // empty when the line is invalid
+        std::string error;
+    };
+
+    // The bytes of rule::save_schema, read where they are: a buffer, an
+    // array compiled into the program (see rule::save_schema_source) or a
+    // mapped file. A rule made from a schema points into these bytes, so
+    // they have to outlive it.
+    class schema {
+    public:
+        schema(const void* data, size_t size) : bytes_(static_cast<const char*>(data), size) {
+            check();
+        }
+        explicit schema(std::string_view bytes) : bytes_(bytes) {
+            check();
+        }
+        static schema map_file(const std::string& path) {
+            return schema(detail::mapped_file(path.c_str()));
+        }
+
+        std::string_view bytes() const {
+            return file_ ? file_->text() : bytes_;
+        }
+
+    private:
+        explicit schema(detail::mapped_file file) : file_(std::move(file)) {
+            check();
+        }
+        void check() const {
+            std::string_view image = bytes();
+            detail::SchemaReader in(image);
+            in.check(0, detail::schema_header_size);
+            if (std::memcmp(image.data(), detail::schema_magic, sizeof(detail::schema_magic)) != 0 ||
+                in.u32(8) != detail::schema_byte_order || in.u32(12) != image.size()) {
+                throw std::runtime_error("Invalid schema image.");
+            }
+        }
+
+        std::optional<detail::mapped_file> file_;
+        std::string_view bytes_;
+    };
+
+    // Everything a rule keeps (options, parameters, names, messages,
+    // validators and the given values) is allocated from resource, so an
+    // arena such as std::pmr::monotonic_buffer_resource can hold a whole
+    // rule and drop it at once. Converted values handed out as std::string
+    // or std::vector use the default allocator.
+    class rule {
+    public:
+        rule(std::string help_long = "help", char help_short = 'h',
+             std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+            resource_(resource),
+            help_long(help_long, resource), help_short(help_short),
+            env_prefix_(resource), config_entries_(resource),
+            options_(resource), params_(resource),
+            commands_(resource), command_index_(resource), command_lengths_(resource),
+            help_(nullptr, detail::ResourceDelete{resource}),
+            completion_(nullptr, detail::ResourceDelete{resource})
+        { 
+            void* p = resource_->allocate(sizeof(detail::HelpCache), alignof(detail::HelpCache));
+            help_.reset(new (p) detail::HelpCache(resource_));
+            p = resource_->allocate(sizeof(detail::CompletionCache), alignof(detail::CompletionCache));
+            completion_.reset(new (p) detail::CompletionCache(resource_));
+            add_option(help_long, help_short, "display the usage.");
+        }
+        explicit rule(std::pmr::memory_resource* resource) : rule("help", 'h', resource) {}
+        // A rule read from a schema image. Names, messages, defaults and
+        // candidates stay in the image; a subcommand is read when it is
+        // first selected.
+        explicit rule(const schema& image, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+            rule(resource)
+        {
+            schema_ = image.bytes();
+            detail::SchemaReader in(schema_);
+            load_level(in, in.u32(16));
+        }
+
+        void add_option(std::string long_name, char short_name, std::string message) {
+            add_option_impl<detail::Option>(long_name, short_name, message);
+        }
+        template <class T, class F = detail::null_validator>
+        void add_option(std::string long_name, char short_name, std::string message,
+                        T def_val, F validator = F()) {
+            std::string def = detail::to_str(def_val);
+            add_option_impl<detail::ValueOption, T>(long_name, short_name, message, def, validator);
+        }
+
+        template <class T, class U>
+        void add_option(std::string long_name, char short_name, std::string message,
+                        T def_val, range<U> r) {
+            static_assert(std::is_same<T, U>::value, "missmach between type of value and type of range");
+            std::string def = detail::to_str(def_val);
+            add_option_impl<detail::ValueOption>(long_name, short_name, message, def, r);
+        }
+
+        template <class T>
+        void add_option(std::string long_name, char short_name, std::string message, T def_val, oneof<T> cand) {
+            std::string def = detail::to_str(def_val);
+            add_option_impl<detail::WithCandidateValueOption, T>(long_name, short_name, message, def, cand.candidates());
+        }
+
+        // Option that may be given any number of times, "-I a -I b", each
+        // value split at delimiter unless it is '\0', "--tags=a,b". The
+        // elements are validated one by one and kept in one std::vector<T>,
+        // read by get_option_values or get_option_ref<std::vector<T>>.
+        template <class T, class F = detail::null_validator>
+        void add_list_option(std::string long_name, char short_name, std::string message,
+                             char delimiter = '\0', F validator = F()) {
+            add_list_option_impl<detail::ValueOption, T>(delimiter, long_name, short_name, message, "", validator);
+        }
+
+        template <class T, class U>
+        void add_list_option(std::string long_name, char short_name, std::string message, char delimiter, range<U> r) {
+            static_assert(std::is_same<T, U>::value, "missmach between type of value and type of range");
+            add_list_option_impl<detail::ValueOption, T>(delimiter, long_name, short_name, message, "", r);
+        }
+
+        template <class T>
+        void add_list_option(std::string long_name, char short_name, std::string message, char delimiter, oneof<T> cand) {
+            add_list_option_impl<detail::WithCandidateValueOption, T>(delimiter, long_name, short_name, message, "", cand.candidates());
+        }
+
+        // Expected number of elements of a list option, reserved by each
+        // parse when the first one is bound.
+        void reserve_option(const std::string& long_name, size_t n) {
+            int index = options_.find(long_name);
+            if (index == detail::OptionsInfo::npos || !options_.at(index).is_list()) {
+                throw std::logic_error(long_name + " is not a list option.");
+            }
+            options_.at(index).set_reserve(n);
+        }
+
+        template <class T, class U>
+        void add_parameter(std::string name, std::string message, range<U> r) {
+            static_assert(std::is_same<T, U>::value, "missmach between type of value and type of range");
+            add_parameter_impl<detail::RangeParameter<T>>(name, message, r);
+        }
+
+        void add_parameter(std::string name, std::string message, int max_length = 256) {
+            add_parameter_impl<detail::StringParameter>(name, message, max_length);
+        }
+
+        template <class F>
+        void add_parameter(std::string name, std::string message, int max_length, F validator) {
+            add_parameter_impl<detail::StringParameter>(name, message, max_length, validator);
+        }
+
+        // Trailing parameter that takes all remaining arguments, "<name...>".
+        template <class T, class U>
+        void add_variadic_parameter(std::string name, std::string message, range<U> r) {
+            static_assert(std::is_same<T, U>::value, "missmach between type of value and type of range");
+            add_parameter_impl<detail::RangeParameter<T>>(name, message, r);
+            params_.back().set_variadic();
+        }
+
+        void add_variadic_parameter(std::string name, std::string message, int max_length = 256) {
+            add_parameter_impl<detail::StringParameter>(name, message, max_length);
+            params_.back().set_variadic();
+        }
+
+        template <class F>
+        void add_variadic_parameter(std::string name, std::string message, int max_length, F validator) {
+            add_parameter_impl<detail::StringParameter>(name, message, max_length, validator);
+            params_.back().set_variadic();
+        }
+
+        // "tool db compact": the first argument selects a subcommand, whose
+        // rule is filled by build(rule&) the first time it is selected.
+        // Only the name and the message are kept until then, so adding
+        // many subcommands costs next to nothing. Options of this rule may
+        // still be given after the name, the subcommand's options only
+        // after it. Parameters of this rule come after the subcommand.
+        template <class F>
+        void add_subcommand(std::string name, std::string message, F build) {
+            if (find_command(name) != npos) {
+                throw std::logic_error("duplicated subcommand");
+            }
+            int index = commands_.size();
+            commands_.emplace_back(resource_, name, message, detail::pmr_function<void(rule&)>(std::move(build), resource_));
+            command_index_.insert(command_lower_bound(name), index);
+            command_lengths_.insert(index, name.size());
+            help_->valid = false;
+            completion_->valid = false;
+        }
+
+        void set_argument_storage(argument_storage storage) {
+            storage_ = storage;
+        }
+
+        // Replaces "@path" arguments by the whitespace separated words of
+        // the file at path, quoted like a shell command line. The file is
+        // memory-mapped and read word by word, with argument_storage::view
+        // values point into the mapping, which lives as long as the
+        // parsed values.
+        void set_response_files(bool enable) {
+            response_files_ = enable;
+        }
+
+        void set_validation(validation mode) {
+            if (mode == validation::eager) {
+                cache_.reset();
+                return;
+            }
+            if (!cache_) {
+                void* p = resource_->allocate(sizeof(detail::ValidationCache), alignof(detail::ValidationCache));
+                cache_ = std::unique_ptr<detail::ValidationCache, detail::ResourceDelete>(
+                        new (p) detail::ValidationCache(resource_), detail::ResourceDelete{resource_});
+            }
+            for (size_t i = 0; i < options_.size(); i++) {
+                check_default(options_.at(i));
+            }
+        }
+
+        // Options that are not given on the command line are looked up in
+        // the environment as prefix followed by the long name in upper
+        // case with '-' as '_', e.g. "APP_" and "--dry-run" give
+        // APP_DRY_RUN. Flags take true, false, 1 or 0.
+        void set_env_prefix(std::string prefix) {
+            env_prefix_ = prefix;
+            use_env_ = true;
+        }
+
+        // Options that are neither given nor set in the environment are
+        // taken from the "long_name = value" lines of the file at path.
+        // The file is mapped and scanned once here; each parse only binds
+        // the keys of registered options.
+        void set_config_file(const std::string& path) {
+            detail::mapped_file file(path.c_str());
+            std::pmr::vector<detail::ConfigEntry> entries(resource_);
+            detail::parse_config(file.text(), entries, path);
+            config_.emplace(std::move(file));
+            config_entries_ = std::move(entries);
+        }
+
+#if COMMAND_PARSER_STATS
+        // observer gets the parse_stats of one parse in every sample,
+        // after the parse and also when it failed. The parses of
+        // parse_batch call it from their threads at the same time.
+        // Parses that are not sampled only count.
+        template <class F>
+        void set_stats_observer(F observer, unsigned sample = 1) {
+            void* p = resource_->allocate(sizeof(detail::StatsSink), alignof(detail::StatsSink));
+            stats_ = std::unique_ptr<detail::StatsSink, detail::ResourceDelete>(
+                    new (p) detail::StatsSink(detail::pmr_function<void(const parse_stats&)>(std::move(observer), resource_), sample),
+                    detail::ResourceDelete{resource_});
+        }
+#endif
+
+        void parse(int argc, char const* argv[]) {
+            if (completion_enabled_ && complete(argc, argv, std::cout)) {
+                exit(0);
+            }
+            result_.emplace(new_result(resource_));
+            parse_error error;
+            if (!parse_into(*result_, argc, argv, storage_ == argument_storage::view, error)) {
+                std::cout << "Error: " << error.message() << std::endl << std::endl;
+                selected_usage(argv[0]);
+                exit(1);
+            }
+            if(result_->help()) {
+                selected_usage(argv[0]);
+                exit(0);
+            }
+        }
+
+        // Parses without changing the rule, so a rule that is complete
+        // can be shared by threads that parse concurrently. Only the
+        // result is allocated, from resource. Invalid arguments throw
+        // std::runtime_error, a help request is reported by help().
+        parse_result parse_args(int argc, char const* argv[],
+                                std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const {
+            parse_result result = new_result(resource);
+            parse_error error;
+            if (!parse_into(result, argc, argv, storage_ == argument_storage::view, error)) {
+                throw std::runtime_error(error.message());
+            }
+            return result;
+        }
+
+        // Like parse_args, but invalid arguments are reported through
+        // error instead of an exception, and the result is empty then.
+        // Nothing is printed and no message is built unless asked for.
+        std::optional<parse_result> try_parse(int argc, char const* argv[], parse_error& error,
+                                              std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const {
+            error = parse_error();
+            parse_result result = new_result(resource);
+            if (!parse_into(result, argc, argv, storage_ == argument_storage::view, error)) {
+                return std::nullopt;
+            }
+            return result;
+        }
+
+        // Parses every line of text against this rule, one command per
+        // line with shell-style quoting. Blank lines and lines starting
+        // with '#' are skipped. Lines are shared out in chunks to up to
+        // threads workers, entries come back in input order either way.
+        // Values are always copied, so text may go away afterwards.
+        std::vector<batch_entry> parse_batch(std::string_view text, unsigned threads = 1) const {
+            std::vector<batch_entry> entries;
+            std::vector<std::string_view> lines;
+            size_t number = 0;
+            for (size_t pos = 0; pos < text.size(); ) {
+                size_t end = std::min(text.find('\n', pos), text.size());
+                std::string_view line = text.substr(pos, end - pos);
+                pos = end + 1;
+                number++;
+                size_t first = line.find_first_not_of(" \t\r");
+                if (first == std::string_view::npos || line[first] == '#') {
+                    continue;
+                }
+                entries.push_back(batch_entry{number, std::nullopt, std::string()});
+                lines.push_back(line);
+            }
+
+            constexpr size_t chunk = 256;
+            std::atomic<size_t> next{0};
+            std::exception_ptr failure;
+            std::atomic<bool> failed{false};
+            auto worker = [&] {
+                std::string buffer;
+                std::string storage;
+                std::vector<const char*> argv;
+                try {
+                    for (size_t begin; (begin = next.fetch_add(chunk)) < lines.size(); ) {
+                        size_t end = std::min(begin + chunk, lines.size());
+                        for (size_t i = begin; i < end; i++) {
+                            try {
+                                argv.assign(1, "");
+                                detail::split_command_line(lines[i], buffer, storage, argv);
+                            } catch (std::runtime_error& e) {
+                                entries[i].error = e.what();
+                                continue;
+                            }
+                            parse_result result = new_result(std::pmr::get_default_resource());
+                            parse_error error;
+                            if (parse_into(result, argv.size(), argv.data(), false, error)) {
+                                entries[i].result.emplace(std::move(result));
+                            } else {
+                                entries[i].error = error.message();
+                            }
+                        }
+                    }
+                } catch (...) {
+                    if (!failed.exchange(true)) {
+                        failure = std::current_exception();
+                    }
+                }
+            };
+
+            size_t workers = std::min<size_t>(std::max(threads, 1u), (lines.size() + chunk - 1) / chunk);
+            std::vector<std::thread> pool;
+            for (size_t t = 1; t < workers; t++) {
+                pool.emplace_back(worker);
+            }
+            worker();
+            for (auto& t : pool) {
+                t.join();
+            }
+            if (failure) {
+                std::rethrow_exception(failure);
+            }
+            return entries;
+        }
+
+        std::vector<batch_entry> parse_batch(std::istream& in, unsigned threads = 1) const {
+            std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            return parse_batch(text, threads);
+        }
+
+        bool is_option_use(const std::string& name) const {
+            return options_.is_use(state(), name);
+        }
+        template <class T>
+        T get_option_value(const std::string& option_name) const {
+            return options_.get_value<T>(state(), option_name);
+        }
+
+        template <class T>
+        T get_param_value(const std::string& param_name) const {
+            return params_.get_value<T>(state(), param_name);
+        }
+
+        template <class T>
+        std::vector<T> get_param_values(const std::string& param_name) const {
+            return params_.get_values<T>(state(), param_name);
+        }
+
+        // Converted values without conversion or copy. T must be the
+        // declared type (std::vector<T> for a variadic parameter),
+        // otherwise std::logic_error is thrown.
+        template <class T>
+        const T& get_option_ref(const std::string& option_name) const {
+            return options_.get_ref<T>(state(), option_name);
+        }
+
+        template <class T>
+        const T& get_param_ref(const std::string& param_name) const {
+            return params_.get_ref<T>(state(), param_name);
+        }
+
+        // Text of a value as given (or the default) without conversion.
+        // With argument_storage::view these point into argv, and
+        // get_*_ref<std::string> is not available since no std::string
+        // is built.
+        std::string_view get_option_view(const std::string& option_name) const {
+            return options_.get_view(state(), option_name);
+        }
+
+        std::string_view get_param_view(const std::string& param_name) const {
+            return params_.get_view(state(), param_name);
+        }
+
+        const std::pmr::vector<std::string_view>& get_param_views(const std::string& param_name) const {
+            return params_.get_views(state(), param_name);
+        }
+
+        value_source get_option_source(const std::string& option_name) const {
+            return options_.source(state(), option_name);
+        }
+
+        template <class T>
+        std::vector<T> get_option_values(const std::string& option_name) const {
+            return options_.get_values<T>(state(), option_name);
+        }
+
+        const std::pmr::vector<std::string_view>& get_option_views(const std::string& option_name) const {
+            return options_.get_views(state(), option_name);
+        }
+
+        std::string_view get_command() const {
+            return result_ ? result_->get_command() : std::string_view();
+        }
+        const parse_result& get_subcommand() const {
+            if (!result_) {
+                throw std::logic_error("No subcommand was selected.");
+            }
+            return result_->get_subcommand();
+        }
+
+        // Usage is rendered once into a buffer and written in one call,
+        // later calls with the same program name only write the buffer.
+        // Messages wrap at the width of the terminal, or at width given
+        // to set_help_width (0 detects the terminal).
+        void usage(std::string program) const {
+            usage(program, std::cout);
+        }
+        void usage(std::string_view program, std::ostream& out) const {
+            with_usage(program, [&out](std::string_view text) {
+                out.write(text.data(), text.size());
+                out.flush();
+            });
+        }
+        void usage(std::string_view program, std::FILE* out) const {
+            with_usage(program, [out](std::string_view text) {
+                std::fwrite(text.data(), 1, text.size(), out);
+                std::fflush(out);
+            });
+        }
+#if COMMAND_PARSER_MMAP
+        void usage(std::string_view program, int fd) const {
+            with_usage(program, [fd](std::string_view text) {
+                while (!text.empty()) {
+                    ssize_t n = ::write(fd, text.data(), text.size());
+                    if (n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n <= 0) {
+                        return;
+                    }
+                    text.remove_prefix(n);
+                }
+            });
+        }
+#endif
+        std::string usage_text(std::string_view program) const {
+            std::string text;
+            with_usage(program, [&text](std::string_view t) {
+                text.assign(t);
+            });
+            return text;
+        }
+        void set_help_width(size_t width) {
+            help_width_ = width;
+            help_->valid = false;
+        }
+
+        // Shell completion. The scripts of completion_script run
+        // "program __complete <line>" with the command line up to the
+        // cursor, and the program answers with the words that can
+        // complete its last word, one per line: long option names, oneof
+        // candidates as "--name=value" or after a short option, and
+        // subcommand names. Only names are looked up, nothing is parsed
+        // or validated.
+        static constexpr std::string_view completion_word = "__complete";
+
+        // Lets parse() answer completion requests and exit.
+        void set_completion(bool enable) {
+            completion_enabled_ = enable;
+        }
+
+        // Writes the completions when argv[1] is completion_word and
+        // returns true, otherwise returns false and writes nothing.
+        bool complete(int argc, char const* argv[], std::ostream& out) const {
+            if (argc < 2 || argv[1] != completion_word) {
+                return false;
+            }
+            std::string line;
+            for (int i = 2; i < argc; i++) {
+                line += i == 2 ? "" : " ";
+                line += argv[i];
+            }
+            std::string text;
+            for (const std::string& word : completions(line)) {
+                text += word;
+                text += '\n';
+            }
+            out.write(text.data(), text.size());
+            out.flush();
+            return true;
+        }
+
+        // The words that can complete the last word of line, sorted. A
+        // line that ends with a blank completes a new, empty word.
+        std::vector<std::string> completions(std::string_view line) const {
+            std::vector<std::string> words;
+            std::string storage;
+            std::string_view word;
+            size_t end = 0;
+            try {
+                for (size_t pos = 0; detail::next_word(line, pos, word, storage); end = pos) {
+                    words.emplace_back(word);
+                }
+            } catch (std::runtime_error&) {
+                return {};      // an open quote
+            }
+            if (end < line.size()) {
+                words.emplace_back();
+            }
+            std::vector<std::string> out;
+            if (words.size() >= 2) {
+                complete_words(words, out);
+            }
+            return out;
+        }
+
+        // Script that makes shell complete program, to be sourced from
+        // the shell's startup file or its completion directory.
+        static std::string completion_script(shell sh, std::string_view program) {
+            std::string p(program.substr(program.find_last_of('/') + 1));
+            std::string fn = "_" + p + "_complete";
+            for (char& c : fn) {
+                if (!std::isalnum((unsigned char)c)) {
+                    c = '_';
+                }
+            }
+            std::string w(completion_word);
+            switch (sh) {
+            case shell::bash:
+                // '=' breaks words in bash, so the part of the word
+                // before the one bash completes is cut off the answers.
+                return fn + "() {\n"
+                       "    local line=${COMP_LINE:0:COMP_POINT}\n"
+                       "    local cur=${COMP_WORDS[COMP_CWORD]}\n"
+                       "    local word=${line##*[[:blank:]]}\n"
+                       "    local lead=${word:0:${#word}-${#cur}}\n"
+                       "    local IFS=$'\\n'\n"
+                       "    COMPREPLY=($(" + p + " " + w + " \"$line\" 2>/dev/null))\n"
+                       "    COMPREPLY=(\"${COMPREPLY[@]#\"$lead\"}\")\n"
+                       "    if [[ ${#COMPREPLY[@]} -eq 1 && ${COMPREPLY[0]} == *= ]]; then\n"
+                       "        compopt -o nospace\n"
+                       "    fi\n"
+                       "}\n"
+                       "complete -o default -F " + fn + " " + p + "\n";
+            case shell::zsh:
+                return "#compdef " + p + "\n" +
+                       fn + "() {\n"
+                       "    local -a candidates\n"
+                       "    candidates=(${(f)\"$(" + p + " " + w + " \"${(j: :)words[1,CURRENT]}\" 2>/dev/null)\"})\n"
+                       "    if (( ${#candidates} == 0 )); then\n"
+                       "        _files\n"
+                       "        return\n"
+                       "    fi\n"
+                       "    compadd -S '' -- ${(M)candidates:#*=}\n"
+                       "    compadd -- ${candidates:#*=}\n"
+                       "}\n"
+                       "compdef " + fn + " " + p + "\n";
+            case shell::fish:
+                return "function " + fn + "\n"
+                       "    " + p + " " + w + " (commandline -cp)\n"
+                       "end\n"
+                       "complete -c " + p + " -a '(" + fn + ")'\n";
+            }
+            return std::string();
+        }
+
+        // This rule and its subcommands as an image that rule(schema)
+        // reads back without building them again. Options and parameters
+        // have to be of a type in detail::SchemaTypes with range, oneof
+        // or regex validators; settings such as validation, storage, env
+        // and config are not saved.
+        std::string save_schema() const {
+            detail::SchemaWriter out;
+            out.bytes(detail::schema_magic, sizeof(detail::schema_magic));
+            out.u32(detail::schema_byte_order);
+            out.u32(0);
+            out.u32(0);
+            uint32_t root = save_level(out);
+            out.set(12, out.size());
+            out.set(16, root);
+            return std::move(out.out);
+        }
+        // save_schema as C++ source of an array called name, to compile
+        // the image into the program.
+        std::string save_schema_source(std::string_view name) const {
+            std::string image = save_schema();
+            std::string out = "constexpr unsigned char " + std::string(name) + "[] = {";
+            for (size_t i = 0; i < image.size(); i++) {
+                out += i % 16 == 0 ? "\n    " : " ";
+                out += std::to_string((unsigned char)image[i]);
+                out += ",";
+            }
+            out += "\n};\n";
+            return out;
+        }
+
+    private:
+        static constexpr int npos = -1;
+
+        // A subcommand is only described until it is selected, then its
+        // rule is built once, also when several threads select it.
+        struct Command {
+            Command(std::pmr::memory_resource* resource, std::string_view name, std::string_view message, detail::pmr_function<void(rule&)> build) :
+                name(name, resource),
+                message(message, resource),
+                build(std::move(build)),
+                built(nullptr, detail::ResourceDelete{resource})
+            {
+            }
+            detail::Text name;
+            detail::Text message;
+            detail::pmr_function<void(rule&)> build;
+            uint32_t level = 0;     // of the schema image, instead of build
+            std::once_flag once;
+            std::unique_ptr<rule, detail::ResourceDelete> built;
+        };
+
+        // The rule and the result of one subcommand level during a parse.
+        struct Level {
+            const rule* r;
+            parse_result* result;
+            const Level* up;
+        };
+
+        // Follows the words before the last one through options, their
+        // values and subcommand names, then looks the last one up in the
+        // tries of the selected level and the levels around it.
+        void complete_words(const std::vector<std::string>& words, std::vector<std::string>& out) const {
+            std::vector<const rule*> levels{this};
+            size_t arguments = 0;
+            const rule* value_of = nullptr;     // the last word is the value of this option
+            int value_index = npos;
+            bool ended = false;
+            for (size_t i = 1; i + 1 < words.size(); i++) {
+                std::string_view w = words[i];
+                const rule& r = *levels.back();
+                if (value_of != nullptr) {
+                    value_of = nullptr;
+                    continue;
+                }
+                if (!ended && w == "--") {
+                    ended = true;
+                    continue;
+                }
+                if (!ended && w.size() > 1 && w[0] == '-' && !std::isdigit((unsigned char)w[1])) {
+                    if (w[1] == '-') {
+                        continue;
+                    }
+                    for (size_t k = 1; k < w.size(); k++) {
+                        auto l = std::find_if(levels.rbegin(), levels.rend(), [&](const rule* x) {
+                            return x->options_.find(w[k]) != detail::OptionsInfo::npos;
+                        });
+                        if (l == levels.rend()) {
+                            break;
+                        }
+                        int index = (*l)->options_.find(w[k]);
+                        if ((*l)->options_.at(index).has_value()) {
+                            if (k + 1 == w.size()) {
+                                value_of = *l;
+                                value_index = index;
+                            }
+                            break;
+                        }
+                    }
+                    continue;
+                }
+                if (!r.commands_.empty() && arguments == 0) {
+                    int index = r.find_command(w);
+                    if (index != npos) {
+                        levels.push_back(&r.command(index));
+                        continue;
+                    }
+                }
+                arguments++;
+            }
+
+            std::string_view partial = words.back();
+            if (value_of != nullptr) {
+                std::string prefix = "--" + std::string(value_of->options_.at(value_index).long_name()) + "=";
+                size_t lead = prefix.size();
+                prefix += partial;
+                value_of->complete_prefix(prefix, detail::Completion::value, [&](std::string_view c) {
+                    out.emplace_back(c.substr(lead));
+                });
+                return;
+            }
+            if (!ended && partial.size() > 0 && partial[0] == '-') {
+                detail::Completion kind = partial.substr(0, 2) == "--" && partial.find('=') != std::string_view::npos ?
+                                          detail::Completion::value : detail::Completion::option;
+                for (auto l = levels.rbegin(); l != levels.rend(); ++l) {
+                    (*l)->complete_prefix(partial, kind, [&](std::string_view c) {
+                        out.emplace_back(c);
+                    });
+                }
+                if (levels.size() > 1) {
+                    std::sort(out.begin(), out.end());
+                    out.erase(std::unique(out.begin(), out.end()), out.end());
+                }
+                return;
+            }
+            if (!levels.back()->commands_.empty() && arguments == 0) {
+                levels.back()->complete_prefix(partial, detail::Completion::command, [&](std::string_view c) {
+                    out.emplace_back(c);
+                });
+            }
+        }
+
+        template <class F>
+        void complete_prefix(std::string_view prefix, detail::Completion kind, F f) const {
+            std::lock_guard<std::mutex> lock(completion_->mutex);
+            detail::PrefixTrie& trie = completion_->trie;
+            if (!completion_->valid) {
+                trie.clear();
+                std::string word;
+                for (const detail::Option& op : options_) {
+                    word.assign("--").append(op.long_name());
+                    if (op.has_value()) {
+                        word += '=';
+                    }
+                    trie.add(word, (uint8_t)detail::Completion::option);
+                    for (size_t i = 0; i < op.candidates().size(); i++) {
+                        trie.add(std::string(word).append(op.candidates()[i]), (uint8_t)detail::Completion::value);
+                    }
+                }
+                for (const Command& c : commands_) {
+                    trie.add(c.name, (uint8_t)detail::Completion::command);
+                }
+                trie.seal();
+                completion_->valid = true;
+            }
+            trie.find(prefix, [&](std::string_view word, uint8_t tag) {
+                if (tag == (uint8_t)kind) {
+                    f(word);
+                }
+            });
+        }
+
+        parse_result new_result(std::pmr::memory_resource* resource) const {
+#if COMMAND_PARSER_STATS
+            if (stats_ && stats_->sample()) {
+                void* p = resource->allocate(sizeof(detail::CountingResource), alignof(detail::CountingResource));
+                return parse_result(options_, params_, parse_result::Counter(
+                        new (p) detail::CountingResource(resource), detail::ResourceDelete{resource}));
+            }
+#endif
+            return parse_result(options_, params_, resource);
+        }
+
+        // Returns false with error set when the arguments are invalid.
+        // Errors other than malformed options are reported after the
+        // whole command line was seen, so "--help" always wins.
+        bool parse_into(parse_result& result, int argc, char const* argv[], bool keep_view, parse_error& error) const {
+            detail::parser p(argc, argv, options_, response_files_ ? &result.state_ : nullptr);
+            Level top{this, &result, nullptr};
+#if COMMAND_PARSER_STATS
+            if (result.counter_) {
+                parse_stats stats;
+                detail::Probe probe(stats);
+                result.state_.set_probe(&probe);
+                auto start = std::chrono::steady_clock::now();
+                parse_level(top, p, keep_view, error);
+                stats.total_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count();
+                stats.tokens = p.tokens();
+                stats.allocations = result.counter_->allocations;
+                stats.allocated_bytes = result.counter_->bytes;
+                stats.failed = (bool)error && !result.help();
+                for (parse_result* r = &result; r != nullptr; r = r->sub_.get()) {
+                    r->state_.set_probe(nullptr);
+                }
+                if (result.help()) {
+                    error = parse_error();
+                }
+                stats_->observer(stats);
+                return !error;
+            }
+#endif
+            parse_level(top, p, keep_view, error);
+            if (result.help()) {
+                error = parse_error();
+            }
+            return !error;
+        }
+
+        // Parses the arguments of this level. A subcommand name hands the
+        // rest of the command line to its rule and the values left unset
+        // here are filled once that returns.
+        void parse_level(const Level& level, detail::parser& p, bool keep_view, parse_error& error) const {
+            parse_result& result = *level.result;
+            detail::ParseState& state = result.state_;
+            detail::Argument arg;
+            detail::Probe* probe = state.probe();
+            params_.reserve(state, p.size());
+
+            while(p.next(arg, error)) {
+                if (probe) {
+                    probe->lap(detail::Phase::tokenize);
+                }
+                if(arg.is_option) {
+                    const Level* owner = &level;
+                    for (int i = 0; i < arg.scope; i++) {
+                        owner = owner->up;
+                    }
+                    const rule& r = *owner->r;
+                    const detail::Option& op = r.options_.at(arg.index);
+                    detail::OptionState& s = owner->result->state_.options[arg.index];
+                    if(arg.scope == 0 && op.long_name() == help_long) {
+                        for (const Level* l = &level; l != nullptr; l = l->up) {
+                            l->result->state_.help = true;
+                        }
+                        return;
+                    }
+                    s.source = value_source::command_line;
+                    if (probe) {
+                        probe->option_bound();
+                    }
+                    if (op.is_list()) {
+                        r.bind_list(arg.index, owner->result->state_, arg.value, keep_view, error, arg.position);
+                        continue;
+                    }
+                    if(arg.value == "") {
+                        s.use = true;
+                    } else {
+                        op.set(s, arg.value, keep_view);
+                    }
+                    if (probe) {
+                        probe->lap(detail::Phase::option);
+                    }
+                    r.validate_option(arg.index, owner->result->state_, error, arg.position);
+                    continue;
+                }
+                if (!commands_.empty() && result.command_.empty() && (state.params.empty() || !state.params[0].bound)) {
+                    int index = find_command(arg.value);
+                    if (index != npos) {
+                        const rule& sub = command(index);
+                        result.command_ = commands_[index].name;
+                        std::pmr::memory_resource* resource = state.options.get_allocator().resource();
+                        void* mem = resource->allocate(sizeof(parse_result), alignof(parse_result));
+                        result.sub_.reset(new (mem) parse_result(sub.options_, sub.params_, resource));
+                        result.sub_->state_.set_probe(probe);
+                        p.push(sub.options_);
+                        Level next{&sub, result.sub_.get(), &level};
+                        sub.parse_level(next, p, keep_view, error);
+                        if (state.help || p.failed()) {
+                            return;
+                        }
+                        break;
+                    }
+                    if (params_.size() == 0) {
+                        p.fail(error, parse_errc::unknown_command, arg, nullptr, arg.value);
+                        detail::Suggestions near(arg.value);
+                        near.consider(command_lengths_, [this](uint32_t i) { return std::string_view(commands_[i].name); });
+                        error.suggestions_ = near.take();
+                        return;
+                    }
+                }
+                size_t index = params_.set(state, arg.value, keep_view);
+                if (index == detail::ParametersInfo::npos) {
+                    error.add(parse_errc::too_many_arguments, arg.position, nullptr, nullptr, arg.value);
+                } else {
+                    if (probe) {
+                        probe->argument_bound();
+                        probe->lap(detail::Phase::positional);
+                    }
+                    validate_parameter(index, state, arg.value, error, arg.position);
+                }
+            }
+            if (p.failed()) {
+                return;
+            }
+            if (!commands_.empty() && result.command_.empty() && params_.size() == 0) {
+                error.add(parse_errc::no_command, -1, nullptr, nullptr, std::string_view());
+            }
+
+            // Options not given on the command line, from the environment
+            // and then the config file, whose last entry for a key wins.
+            if (use_env_) {
+                std::string name;
+                for (size_t i = 0; i < options_.size(); i++) {
+                    if (state.options[i].source != value_source::default_value) {
+                        continue;
+                    }
+                    name.assign(env_prefix_);
+                    for (char c : options_.at(i).long_name()) {
+                        name.push_back(c == '-' ? '_' : std::toupper((unsigned char)c));
+                    }
+                    if (const char* value = std::getenv(name.c_str())) {
+                        // The environment may change, so its values are copied.
+                        bind_source(i, state, value, value_source::environment, false, error);
+                    }
+                }
+            }
+            for (auto it = config_entries_.rbegin(); it != config_entries_.rend(); ++it) {
+                int index = options_.find(it->key);
+                if (index == detail::OptionsInfo::npos || state.options[index].source != value_source::default_value) {
+                    continue;
+                }
+                bind_source(index, state, it->value, value_source::config_file, keep_view, error);
+            }
+
+            // Defaults of options that were not given and missing arguments.
+            // Lazy validation checked the defaults when they were added.
+            if (probe) {
+                probe->lap(detail::Phase::option);
+            }
+            for(size_t i = 0; i < options_.size(); i++) {
+                if(cache_ && state.options[i].source == value_source::default_value) {
+                    continue;
+                }
+                if(!state.options[i].use && !options_.at(i).is_list()) {
+                    validate_option(i, state, error, -1);
+                }
+            }
+            for(size_t i = 0; i < params_.size(); i++) {
+                if(!state.params[i].bound) {
+                    error.add(parse_errc::missing_argument, -1, nullptr, &params_.at(i), std::string_view());
+                }
+            }
+        }
+
+        const detail::ParseState& state() const {
+            static const detail::ParseState unparsed(std::pmr::get_default_resource(), 0, 0);
+            return result_ ? result_->state_ : unparsed;
+        }
+
+        std::pmr::vector<int>::const_iterator command_lower_bound(std::string_view name) const {
+            return std::lower_bound(command_index_.begin(), command_index_.end(), name,
+                    [this](int index, std::string_view n) {
+                        return commands_[index].name < n;
+                    });
+        }
+        int find_command(std::string_view name) const {
+            auto it = command_lower_bound(name);
+            if (it != command_index_.end() && commands_[*it].name == name) {
+                return *it;
+            }
+            return npos;
+        }
+        // Rule of a subcommand, built the first time it is asked for.
+        const rule& command(int index) const {
+            Command& c = commands_[index];
+            std::call_once(c.once, [&] {
+                void* mem = resource_->allocate(sizeof(rule), alignof(rule));
+                std::unique_ptr<rule, detail::ResourceDelete> sub(
+                        new (mem) rule(std::string(help_long), help_short, resource_), detail::ResourceDelete{resource_});
+                sub->set_argument_storage(storage_);
+                if (c.level != 0) {
+                    sub->schema_ = schema_;
+                    sub->load_level(detail::SchemaReader(schema_), c.level);
+                } else {
+                    c.build(*sub);
+                }
+                c.built = std::move(sub);
+            });
+            return *c.built;
+        }
+
+        // Type code of an option or a parameter for a schema image.
+        template <class Item>
+        static uint32_t schema_type(const Item& item, std::string_view name) {
+            const char* why = nullptr;
+            uint32_t code = item.type() ? detail::schema_type_code(item.type()) : detail::no_schema_type;
+            if (item.has_validator()) {
+                why = "it has a user validator.";
+            } else if (item.type() && code == detail::no_schema_type) {
+                why = "its type is not supported.";
+            } else if (item.has_range() && !item.range_bounds().set) {
+                why = "its range is not supported.";
+            }
+            if (why != nullptr) {
+                throw std::logic_error("\"" + std::string(name) + "\" cannot be saved in a schema, " + why);
+            }
+            return code;
+        }
+        template <class Item>
+        static uint32_t schema_flags(const Item& item) {
+            return (item.has_range() ? detail::schema_range : 0) | (item.pattern() ? detail::schema_pattern : 0);
+        }
+        template <class Item>
+        static void save_pattern(detail::SchemaWriter& out, detail::SchemaWriter::Str text, const Item& item) {
+            out.str(text);
+            out.u32(item.pattern() ? (uint32_t)item.pattern()->flags() : 0);
+            out.bytes(item.range_bounds().min, sizeof(item.range_bounds().min));
+            out.bytes(item.range_bounds().max, sizeof(item.range_bounds().max));
+        }
+
+        // Writes the records of this rule after those of its subcommands,
+        // returns where its own record starts.
+        uint32_t save_level(detail::SchemaWriter& out) const {
+            using Str = detail::SchemaWriter::Str;
+            std::vector<uint32_t> levels;
+            for (size_t i = 0; i < commands_.size(); i++) {
+                levels.push_back(command((int)i).save_level(out));
+            }
+            std::vector<uint32_t> types;
+            std::vector<Str> text;
+            std::vector<uint32_t> arrays;
+            Str help = out.text(help_long);
+            for (size_t i = 0; i < options_.size(); i++) {
+                const detail::Option& op = options_.at(i);
+                types.push_back(schema_type(op, op.long_name()));
+                text.push_back(out.text(op.long_name()));
+                text.push_back(out.text(op.message()));
+                text.push_back(out.text(op.default_value()));
+                text.push_back(out.text(op.pattern() ? std::string_view(op.pattern()->pattern()) : std::string_view()));
+                text.push_back(out.text(op.candidates().text()));
+                arrays.push_back(out.pairs(op.candidates().entries()));
+                arrays.push_back(out.pairs(op.candidates().lengths().entries()));
+            }
+            for (size_t i = 0; i < params_.size(); i++) {
+                const detail::Parameter& p = params_.at(i);
+                types.push_back(schema_type(p, p.name()));
+                text.push_back(out.text(p.name()));
+                text.push_back(out.text(p.message()));
+                text.push_back(out.text(p.pattern() ? std::string_view(p.pattern()->pattern()) : std::string_view()));
+            }
+            for (const Command& c : commands_) {
+                text.push_back(out.text(c.name));
+                text.push_back(out.text(c.message));
+            }
+            uint32_t sorted_at = out.size();
+            for (int index : options_.sorted()) {
+                out.u32(index);
+            }
+            uint32_t lengths_at = out.pairs(options_.lengths().entries());
+            uint32_t command_index_at = out.size();
+            for (int index : command_index_) {
+                out.u32(index);
+            }
+            uint32_t command_lengths_at = out.pairs(command_lengths_.entries());
+
+            const Str* t = text.data();
+            uint32_t options_at = out.size();
+            for (size_t i = 0; i < options_.size(); i++, t += 5) {
+                const detail::Option& op = options_.at(i);
+                out.str(t[0]);
+                out.str(t[1]);
+                out.str(t[2]);
+                out.u32((unsigned char)op.short_name());
+                out.u32((op.has_value() ? detail::schema_has_value : 0) | (op.is_list() ? detail::schema_list : 0) | schema_flags(op));
+                out.u32((unsigned char)op.delimiter());
+                out.u32(types[i]);
+                out.u32((uint32_t)op.reserve_hint());
+                out.str(t[4]);
+                out.u32(arrays[2 * i]);
+                out.u32((uint32_t)op.candidates().size());
+                out.u32(arrays[2 * i + 1]);
+                save_pattern(out, t[3], op);
+            }
+            uint32_t params_at = out.size();
+            for (size_t i = 0; i < params_.size(); i++, t += 3) {
+                const detail::Parameter& p = params_.at(i);
+                out.u32(p.get_order());
+                out.str(t[0]);
+                out.str(t[1]);
+                out.u32((p.is_variadic() ? detail::schema_variadic : 0) | schema_flags(p));
+                out.u32(types[options_.size() + i]);
+                out.u32((uint32_t)p.max_length());
+                save_pattern(out, t[2], p);
+            }
+            uint32_t commands_at = out.size();
+            for (size_t i = 0; i < commands_.size(); i++, t += 2) {
+                out.str(t[0]);
+                out.str(t[1]);
+                out.u32(levels[i]);
+            }
+
+            uint32_t at = out.size();
+            out.str(help);
+            out.u32((unsigned char)help_short);
+            out.u32((uint32_t)options_.size());
+            out.u32(options_at);
+            out.u32(sorted_at);
+            out.u32(lengths_at);
+            out.u32((uint32_t)params_.size());
+            out.u32(params_at);
+            out.u32((uint32_t)commands_.size());
+            out.u32(commands_at);
+            out.u32(command_index_at);
+            out.u32(command_lengths_at);
+            return at;
+        }
+
+        // Declares the type of item and what comes with it.
+        template <class Item>
+        static void load_type(Item& item, uint32_t code, uint32_t flags, const detail::RangeBounds& bounds, char delimiter = '\0') {
+            if (code == detail::no_schema_type) {
+                return;
+            }
+            bool known = detail::with_schema_type(code, [&](auto* type) {
+                using T = std::remove_pointer_t<decltype(type)>;
+                item.template set_type<T>();
+                if constexpr (std::is_arithmetic<T>::value) {
+                    if (flags & detail::schema_range) {
+                        item.set_range(bounds.template get<T>());
+                    }
+                }
+                if constexpr (std::is_same<Item, detail::Option>::value) {
+                    if (flags & detail::schema_list) {
+                        item.template set_list<T>(delimiter);
+                    }
+                }
+            });
+            if (!known) {
+                throw std::runtime_error("Invalid schema image.");
+            }
+        }
+        template <class Item>
+        static void load_pattern(Item& item, detail::SchemaFields& f, uint32_t flags) {
+            std::string_view pattern = f.text();
+            uint32_t pattern_flags = f.next();
+            if (flags & detail::schema_pattern) {
+                item.set_validator(regex(std::string(pattern), static_cast<std::regex::flag_type>(pattern_flags)));
+            }
+        }
+
+        // Reads the level record at of the image into this rule, the
+        // counterpart of save_level. Texts are borrowed from the image.
+        void load_level(const detail::SchemaReader& in, uint32_t at) {
+            detail::SchemaFields f{in, at};
+            help_long.assign(f.text());
+            help_short = (char)f.next();
+            uint32_t option_count = f.next();
+            uint32_t options_at = f.next();
+            uint32_t sorted_at = f.next();
+            uint32_t lengths_at = f.next();
+            uint32_t param_count = f.next();
+            uint32_t params_at = f.next();
+            uint32_t command_count = f.next();
+            uint32_t commands_at = f.next();
+            uint32_t command_index_at = f.next();
+            uint32_t command_lengths_at = f.next();
+            in.check(options_at, uint64_t(option_count) * detail::schema_option_fields * 4);
+            in.check(params_at, uint64_t(param_count) * detail::schema_parameter_fields * 4);
+            in.check(commands_at, uint64_t(command_count) * detail::schema_command_fields * 4);
+
+            std::pmr::vector<detail::Option> options(resource_);
+            options.reserve(option_count);
+            for (uint32_t i = 0; i < option_count; i++) {
+                detail::SchemaFields o{in, options_at + i * detail::schema_option_fields * 4};
+                std::string_view lname = o.text();
+                std::string_view message = o.text();
+                std::string_view value = o.text();
+                char sname = (char)o.next();
+                uint32_t flags = o.next();
+                char delimiter = (char)o.next();
+                uint32_t type = o.next();
+                uint32_t reserve = o.next();
+                std::string_view candidates = o.text();
+                uint32_t entries_at = o.next();
+                uint32_t count = o.next();
+                uint32_t candidate_lengths_at = o.next();
+
+                detail::Option& op = options.emplace_back(resource_, std::string_view(), sname, std::string_view());
+                op.borrow(lname, message, value);
+                op.set_has_value(flags & detail::schema_has_value);
+                if (reserve != 0) {
+                    op.set_reserve(reserve);
                 }
-                order_map_.insert(std::make_pair(op->name(), order_index_));
-                params_.insert(std::make_pair(order_index_, std::move(op)));
-                order_index_++;
+                if (count != 0) {
+                    auto entries = in.pairs(entries_at, count, [&](const auto& e) {
+                        return uint64_t(e.first) + e.second <= candidates.size();
+                    }, resource_);
+                    auto lengths = in.pairs(candidate_lengths_at, count, [&](const auto& e) {
+                        return e.second < count;
+                    }, resource_);
+                    op.candidates().borrow(candidates, std::move(entries), std::move(lengths));
+                }
+                load_pattern(op, o, flags);
+                detail::RangeBounds bounds;
+                o.bytes(bounds.min, sizeof(bounds.min));
+                o.bytes(bounds.max, sizeof(bounds.max));
+                load_type(op, type, flags, bounds, delimiter);
             }
+            auto sorted = in.indexes(sorted_at, option_count, option_count, resource_);
+            auto lengths = in.pairs(lengths_at, option_count, [&](const auto& e) {
+                return e.second < option_count;
+            }, resource_);
+            options_.restore(std::move(options), std::move(sorted), std::move(lengths));
 
-            void set(const std::string value) {
-                for (auto& i : params_) {
-                    if( i.second->is_use() == false) {
-                        i.second->set(value);
-                        return;
-                    }
+            detail::ParametersInfo params(resource_);
+            for (uint32_t i = 0; i < param_count; i++) {
+                detail::SchemaFields p{in, params_at + i * detail::schema_parameter_fields * 4};
+                int order = (int)p.next();
+                std::string_view name = p.text();
+                std::string_view message = p.text();
+                uint32_t flags = p.next();
+                uint32_t type = p.next();
+                int max_length = (int)p.next();
+
+                detail::Parameter param(resource_, order, std::string_view(), std::string_view());
+                param.borrow(name, message);
+                if (flags & detail::schema_variadic) {
+                    param.set_variadic();
                 }
-                throw std::runtime_error("Parameter invalid");
+                param.set_max_length(max_length);
+                load_pattern(param, p, flags);
+                detail::RangeBounds bounds;
+                p.bytes(bounds.min, sizeof(bounds.min));
+                p.bytes(bounds.max, sizeof(bounds.max));
+                load_type(param, type, flags, bounds);
+                params.add(std::move(param));
             }
+            params_ = std::move(params);
 
-            size_t size() const {
-                return params_.size();
+            for (uint32_t i = 0; i < command_count; i++) {
+                detail::SchemaFields c{in, commands_at + i * detail::schema_command_fields * 4};
+                std::string_view name = c.text();
+                std::string_view message = c.text();
+                Command& command = commands_.emplace_back(resource_, std::string_view(), std::string_view(), detail::pmr_function<void(rule&)>());
+                command.name.borrow(name);
+                command.message.borrow(message);
+                command.level = c.next();
             }
+            command_index_ = in.indexes(command_index_at, command_count, command_count, resource_);
+            command_lengths_.assign(in.pairs(command_lengths_at, command_count, [&](const auto& e) {
+                return e.second < command_count;
+            }, resource_));
+            help_->valid = false;
+            completion_->valid = false;
+        }
 
-            bool is_exist(const std::string& name) const {
-                return order_map_.count(name) == 1;
+        // Usage of the subcommand the last parse() selected.
+        void selected_usage(std::string program) const {
+            const rule* r = this;
+            const parse_result* res = result_ ? &*result_ : nullptr;
+            while (res != nullptr && res->sub_) {
+                program += " ";
+                program += res->command_;
+                r = &r->command(r->find_command(res->command_));
+                res = res->sub_.get();
             }
+            r->usage(program);
+        }
 
-            template <class T>
-            T get_value(const std::string& param) const {
-                if(is_exist(param) == false) {
-                    throw std::logic_error(param + "is not defined.");
-                }
-                return convert<T>(params_.at(order_map_.at(param))->value());
+        template <class F>
+        void with_usage(std::string_view program, F sink) const {
+            size_t width = help_width_ != 0 ? help_width_ : detail::terminal_width();
+            std::lock_guard<std::mutex> lock(help_->mutex);
+            if (!help_->valid || help_->width != width || help_->program != program) {
+                help_->text.clear();
+                render_usage(help_->text, program, width);
+                help_->program.assign(program);
+                help_->width = width;
+                help_->valid = true;
             }
+            sink(std::string_view(help_->text));
+        }
 
-            auto begin() { return params_.begin(); }
-            const auto begin() const { return params_.begin(); }
-
-            auto end() { return params_.end(); }
-            const auto end() const { return params_.end(); }
-        private:
-            int order_index_ = 0;
-            std::map<std::string, int> order_map_;
-            std::map<int, std::unique_ptr<Parameter>> params_;
-        };
-
-
-        class parser {
-            enum class OptionType {
-                NOT_OP = -1,
-                LONG = 1,
-                LONG_WITH_VAL = 2,
-                SHORT = 3,
-            };
-
-        public:
-            parser(int argc, char const* argv[], detail::OptionsInfo& info) : 
-                argc_(argc),
-                argv_(argv),
-                option_info_(info)
-            {
+        void render_usage(std::pmr::string& out, std::string_view program, size_t width) const {
+            size_t estimate = 64 + program.size();
+            for (int index : options_.sorted()) {
+                estimate += options_.get_max_length() + 40 + options_.at(index).message().size();
+            }
+            for (const auto& p : params_) {
+                estimate += 2 * p.name().size() + 16 + p.message().size();
             }
+            for (const auto& c : commands_) {
+                estimate += c.name.size() + 8 + c.message.size();
+            }
+            out.reserve(estimate);
 
-            std::pair<std::string, std::string> next_option() {
-                for(;  id_op_ < argc_; id_op_++) {
-                    std::string arg = argv_[id_op_];
+            out += "Usage: ";
+            out += program;
+            out += " ";
+            if( !options_.empty() ){
+                out += "[Options ...] ";
+            }
+            if( !commands_.empty() ){
+                out += "<command> ";
+            }
+            for (const auto& p : params_) {
+                out += "<";
+                out += p.name();
+                out += p.is_variadic() ? "...> " : "> ";
+            }
+            out += "\n";
 
-                    OptionType opt = option_type(arg);
-                    if (opt == OptionType::NOT_OP) {
-                        continue;
-                    }
-                    if (opt == OptionType::LONG) {
-                        std::string op(arg.substr(2));
-                        id_op_+=1;
-                        if(option_info_.has_value(op) == true) {
-                            throw std::runtime_error("Option \"--" + op + "\" need a value.");
-                        }
-                        return std::make_pair(std::move(op), "");
-                    } else if (opt == OptionType::LONG_WITH_VAL) {
-                        std::string op(arg.substr(2, arg.find("=")-2));
-                        std::string value(arg.substr(arg.find("=")+1));
-
-                        id_op_+=1;
-                        if(option_info_.has_value(op) == true) {
-                            return std::make_pair(std::move(op), std::move(value));
-                        } else {
-                            throw std::runtime_error("Option " + op + " does't need a value.");
-                        }
-                    } else if (opt == OptionType::SHORT) {
-                        std::string op(option_info_.to_long_name(arg.at(1)));
-
-                        if(option_info_.has_value(op)) {
-                            if(id_op_+1 < argc_) {
-                                std::string value(argv_[id_op_+1]);
-                                id_op_+=2;
-                                return std::make_pair(std::move(op), std::move(value));
-                            } else {
-                            throw std::runtime_error("Option \"" + arg + "\" need a value.");
-                            }
-                        } else {
-                            id_op_+=1;
-                            return std::make_pair(std::move(op), "");
-                        }
+            std::string message;
+            auto entry = [&](size_t start) {
+                detail::append_wrapped(out, message, detail::column_of(std::string_view(out).substr(start)), width);
+                out += "\n";
+            };
+            if( !options_.empty() ) {
+                out += "\nOptions:\n";
+                for(int index : options_.sorted()) {
+                    const detail::Option& op = options_.at(index);
+                    size_t start = out.size();
+                    out += "  --";
+                    out += op.long_name();
+                    size_t padding = options_.get_max_length() - op.long_name().size();
+                    if(op.has_value()) {
+                        out += "=<value> ";
+                        out.append(padding, ' ');
+                        out += "[-";
+                        out += op.short_name();
+                        out += " <value>]\t";
                     } else {
-                        throw std::runtime_error("command invalid");
+                        out += " ";
+                        out.append(padding + 8, ' ');
+                        out += "[-";
+                        out += op.short_name();
+                        out += "]       \t";
                     }
+                    message.clear();
+                    op.describe(message);
+                    entry(start);
                 }
-                return std::make_pair("", "");
             }
 
-            std::string next_parameter() {
-                for(; id_p_ < argc_; id_p_++) {
-                    std::string arg = argv_[id_p_];
-
-                    OptionType opt = option_type(arg);
-                    if (opt == OptionType::NOT_OP) {
-                        id_p_++;
-                        return arg;
-                    } else if (opt == OptionType::SHORT) {
-                        std::string op(option_info_.to_long_name(arg.at(1)));
-                        if(option_info_.has_value(op)) {
-                            id_p_++;
-                        }
-                        continue;
-                    }
+            if( !commands_.empty() ) {
+                out += "\nCommands:\n";
+                for(int index : command_index_) {
+                    size_t start = out.size();
+                    out += "  ";
+                    out += commands_[index].name;
+                    out += ":\t";
+                    message.assign(commands_[index].message);
+                    entry(start);
                 }
-                return "";
             }
-        private:
 
-            OptionType option_type(const std::string& param) const {
-                if (std::regex_match(param, lvtype_)) {
-                    return OptionType::LONG_WITH_VAL;
-                }
-                if (std::regex_match(param, ltype_)) {
-                    return OptionType::LONG;
+            if( params_.size() > 0) {
+                out += "\nArguments:\n";
+                for(const auto& p : params_) {
+                    size_t start = out.size();
+                    out += "  ";
+                    out += p.name();
+                    out += ":\t";
+                    message.clear();
+                    p.describe(message);
+                    entry(start);
                 }
-                if (std::regex_match(param, stype_)) {
-                    return OptionType::SHORT;
+            }
+        }
+
+        void bind_source(int index, detail::ParseState& state, std::string_view value, value_source source, bool keep_view, parse_error& error) const {
+            const detail::Option& op = options_.at(index);
+            detail::OptionState& s = state.options[index];
+            s.source = source;
+            if (op.is_list()) {
+                bind_list(index, state, value, keep_view, error, -1);
+                return;
+            }
+            if (op.has_value()) {
+                op.set(s, value, keep_view);
+            } else {
+                convert_result<bool> on = try_convert<bool>(value);
+                if (!on) {
+                    error.add(parse_errc::invalid_value, -1, &op, nullptr, value);
+                    return;
                 }
-                return OptionType::NOT_OP;
+                s.use = on.value;
             }
+            if (detail::Probe* probe = state.probe()) {
+                probe->lap(detail::Phase::option);
+            }
+            validate_option(index, state, error, -1);
+        }
 
-            int argc_;
-            char const** argv_;
-            detail::OptionsInfo& option_info_;
+        // Each element is checked and kept as a view into value, which is
+        // copied once into the state unless keep_view.
+        void bind_list(int index, detail::ParseState& state, std::string_view value, bool keep_view, parse_error& error, int position) const {
+            const detail::Option& op = options_.at(index);
+            if (!keep_view && !value.empty()) {
+                value = state.words.emplace_back(value);
+            }
+            detail::Probe* probe = state.probe();
+            if (probe) {
+                probe->lap(detail::Phase::option);
+            }
+            std::string message;
+            std::string_view bad;
+            parse_errc code = op.append(state.options[index], value, keep_view, message, bad);
+            if (probe) {
+                probe->lap(detail::Phase::conversion);
+            }
+            if (code != parse_errc::none) {
+                error.add(code, position, &op, nullptr, bad, std::move(message));
+            }
+        }
 
-            int id_op_ = 1;
-            int id_p_ = 1;
+        // Converts and checks the value of an option and keeps the
+        // converted value in s when it passed. With lazy validation a
+        // value that passed once is taken from the cache when it comes
+        // again.
+        bool validate_option(int index, detail::ParseState& state, parse_error& error, int position) const {
+            const detail::Option& op = options_.at(index);
+            detail::OptionState& s = state.options[index];
+            std::string_view raw = op.has_value() ? op.value(s) : std::string_view();
+            detail::Probe* probe = state.probe();
+            if (cache_ && cache_->find_option(index, raw, s.typed)) {
+                if (probe) {
+                    probe->lap(detail::Phase::validation);
+                }
+                return true;
+            }
+            detail::typed_value v(s.typed.resource());
+            std::string message;
+            parse_errc code = check(op, op.long_name(), raw, s.is_view, v, message, probe);
+            if (code != parse_errc::none) {
+                error.add(code, position, &op, nullptr, raw, std::move(message));
+                return false;
+            }
+            s.typed = std::move(v);
+            if (cache_) {
+                cache_->store_option(index, raw, s.typed);
+            }
+            return true;
+        }
+        // Same for one value bound to a parameter, appended to the list of
+        // a variadic one.
+        bool validate_parameter(size_t index, detail::ParseState& state, std::string_view value, parse_error& error, int position) const {
+            const detail::Parameter& p = params_.at(index);
+            detail::ParameterState& s = state.params[index];
+            detail::Probe* probe = state.probe();
+            detail::typed_value v(s.typed.resource());
+            if (!cache_ || !cache_->find_param(index, value, v)) {
+                std::string message;
+                parse_errc code = check(p, p.name(), value, s.is_view, v, message, probe);
+                if (code != parse_errc::none) {
+                    error.add(code, position, nullptr, &p, value, std::move(message));
+                    return false;
+                }
+                if (cache_) {
+                    cache_->store_param(index, value, v);
+                }
+            } else if (probe) {
+                probe->lap(detail::Phase::validation);
+            }
+            p.store(s, v);
+            return true;
+        }
 
-            std::regex lvtype_ {"--[\\w|-]*=.*"};
-            std::regex ltype_ {"--[\\w]*"};
-            std::regex stype_ {"-[\\w]"};
-        };
-    };  // namespace detail
+        // Option::check or Parameter::check, with each step charged to
+        // its phase when the parse is sampled.
+        template <class Item>
+        static parse_errc check(const Item& item, std::string_view name, std::string_view raw, bool is_view,
+                                detail::typed_value& out, std::string& message, detail::Probe* probe) {
+            if (!probe) {
+                return item.check(raw, is_view, out, message);
+            }
+            parse_errc code = item.convert(raw, is_view, out, message);
+            probe->lap(detail::Phase::conversion);
+            if (code != parse_errc::none) {
+                return code;
+            }
+            code = item.check_value(raw, out);
+            probe->lap(detail::Phase::validation);
+            if (code != parse_errc::none || !item.has_validator()) {
+                return code;
+            }
+            code = item.check_user(raw, message);
+            probe->lap_validator(name);
+            return code;
+        }
 
-    class rule {
-    public:
-        rule(std::string help_long = "help", char help_short = 'h') : 
-            help_long(help_long), help_short(help_short) 
-        { 
-            add_option(help_long, help_short, "display the usage.");
+        // Lazy validation checks a default once, here, and keeps its
+        // converted value in the option.
+        void check_default(detail::Option& op) {
+            if (!cache_ || !op.has_value() || op.is_list()) {
+                return;
+            }
+            detail::OptionState s(resource_);
+            detail::typed_value v(resource_);
+            std::string detail;
+            parse_errc code = op.check(op.value(s), false, v, detail);
+            if (code != parse_errc::none) {
+                parse_error error;
+                error.set(code, -1, &op, nullptr, op.value(s), std::move(detail));
+                throw std::logic_error("Invalid default value. " + error.message());
+            }
+            op.set_default_typed(std::move(v));
         }
 
-        void add_option(std::string long_name, char short_name, std::string message) {
-            add_option_impl<detail::Option>(long_name, short_name, message);
+        template <class T, class ... Args>
+        void add_parameter_impl(Args ... args) {
+            int order = params_.size()+1;
+            params_.add(T(resource_, order, std::forward<Args>(args)...));
+            help_->valid = false;
         }
-        template <class T>
-        void add_option(std::string long_name, char short_name, std::string message,
-                        T def_val, std::function<bool(const std::string&)> validator = detail::_null_validator_) {
-            std::string def = detail::to_str(def_val);
-            add_option_impl<detail::ValueOption>(long_name, short_name, message, def, validator);
+        // Value is the declared type when the option class does not set it.
+        template <class T, class Value = void, class ... Args>
+        void add_option_impl(Args ... args) {
+            T op(resource_, std::forward<Args>(args)...);
+            if constexpr (!std::is_void<Value>::value) {
+                op.template set_type<Value>();
+            }
+            check_default(op);
+            options_.add(std::move(op));
+            help_->valid = false;
+            completion_->valid = false;
+        }
+        template <class T, class Value, class ... Args>
+        void add_list_option_impl(char delimiter, Args ... args) {
+            T op(resource_, std::forward<Args>(args)...);
+            op.template set_type<Value>();
+            op.template set_list<Value>(delimiter);
+            options_.add(std::move(op));
+            help_->valid = false;
+            completion_->valid = false;
         }
 
-        template <class T, class U>
-        void add_option(std::string long_name, char short_name, std::string message,
-                        T def_val, range<U> r) {
-            static_assert(std::is_same<T, U>::value, "missmach between type of value and type of range");
-            std::string def = detail::to_str(def_val);
-            add_option_impl<detail::ValueOption>(long_name, short_name, message, def, r);
+        std::pmr::memory_resource* resource_;
+        std::pmr::string help_long;
+        char help_short;
+        argument_storage storage_ = argument_storage::owned;
+        bool response_files_ = false;
+        bool use_env_ = false;
+        std::pmr::string env_prefix_;
+        std::optional<detail::mapped_file> config_;
+        std::pmr::vector<detail::ConfigEntry> config_entries_;
+        detail::OptionsInfo options_;
+        detail::ParametersInfo params_;
+        mutable std::pmr::deque<Command> commands_;
+        std::pmr::vector<int> command_index_;     // sorted by name
+        detail::LengthIndex command_lengths_;
+        std::optional<parse_result> result_;
+        std::unique_ptr<detail::ValidationCache, detail::ResourceDelete> cache_;
+        size_t help_width_ = 0;
+        std::unique_ptr<detail::HelpCache, detail::ResourceDelete> help_;
+        bool completion_enabled_ = false;
+        std::unique_ptr<detail::CompletionCache, detail::ResourceDelete> completion_;
+        std::string_view schema_;       // image the rule was read from
+#if COMMAND_PARSER_STATS
+        std::unique_ptr<detail::StatsSink, detail::ResourceDelete> stats_{nullptr, detail::ResourceDelete{nullptr}};
+#endif
+    };
+
+
+
+#endif  // COMMAND_PARSER_EXCEPTIONS
+
+#if __cplusplus >= 202002L
+    // Compile-time rule definition.
+    //
+    //   static_rule<
+    //       flag<"verbose", 'v', "verbose output">,
+    //       option<int, "range", 'r', "Support value of range.", 1, in_range<1, 100>>,
+    //       string_option<"pattern", 'p', "Support selectable candidates", "disable", one_of<"disable", "enable">>,
+    //       param<std::string_view, "src", "required parameter", max_length<256>>
+    //   > r;
+    //   r.parse(argc, argv);
+    //   int v = r.get_option_value<"range">();
+    //
+    // Names are resolved through a perfect hash built at compile time and
+    // values live in a tuple of the declared types. String values are views
+    // into argv or into the declaration, so parse() allocates nothing unless
+    // it has to report an error. Unknown names in get_*<"name">() and default
+    // values violating their constraints are compile errors.
+    template <size_t N>
+    struct fixed_string {
+        char data[N] {};
+        constexpr fixed_string(const char (&str)[N]) {
+            for (size_t i = 0; i < N; i++) {
+                data[i] = str[i];
+            }
+        }
+        constexpr std::string_view view() const {
+            return std::string_view(data, N-1);
         }
+    };
 
+    template <auto Min, auto Max>
+    struct in_range {
         template <class T>
-        void add_option(std::string long_name, char short_name, std::string message, T def_val, oneof<T> cand) {
-            std::string def = detail::to_str(def_val);
-            add_option_impl<detail::WithCandidateValueOption>(long_name, short_name, message, def, cand.candidates());
+        static constexpr bool check(const T& val) {
+            return Min <= val && val <= Max;
+        }
+        static std::string error(std::string_view, std::string_view raw) {
+            return std::string(raw) + " is out of range. range is [" + detail::to_str(Min) + ", " + detail::to_str(Max) + "]";
         }
+        static std::string describe() {
+            return " : range is [" + detail::to_str(Min) + ", " + detail::to_str(Max) + "]";
+        }
+    };
 
-        template <class T, class U>
-        void add_parameter(std::string name, std::string message, range<U> r) {
-            static_assert(std::is_same<T, U>::value, "missmach between type of value and type of range");
-            add_parameter_impl<detail::RangeParameter<T>>(name, message, r);
+    template <fixed_string ... Candidates>
+    struct one_of {
+        static constexpr bool check(std::string_view val) {
+            return ((val == Candidates.view()) || ...);
         }
+        static std::string error(std::string_view id, std::string_view raw) {
+            return std::string(id) + " cannot specify the \"" + std::string(raw) + "\"";
+        }
+        static std::string describe() {
+            std::string mes = " : Available pattern {";
+            bool first = true;
+            ((mes += (first ? "" : ", ") + std::string(Candidates.view()), first = false), ...);
+            return mes + "}";
+        }
+    };
 
-        void add_parameter(std::string name, std::string message, int max_length = 256) {
-            add_parameter_impl<detail::StringParameter>(name, message, max_length);
+    template <size_t Max>
+    struct max_length {
+        static constexpr bool check(std::string_view val) {
+            return val.size() <= Max;
+        }
+        static std::string error(std::string_view id, std::string_view) {
+            return "Over-length error. Max length of " + std::string(id) + " is " + detail::to_str(Max) + ".";
         }
+        static std::string describe() {
+            return "";
+        }
+    };
 
-        void add_parameter(std::string name, std::string message, int max_length, std::function<bool(const std::string&)> validator) {
-            add_parameter_impl<detail::StringParameter>(name, message, max_length, validator);
+    namespace detail {
+        enum class DeclKind {
+            FLAG,
+            OPTION,
+            PARAM,
+        };
+
+        template <class ... Constraints>
+        struct constraint_list {
+            template <class T>
+            static constexpr bool check(const T& val) {
+                return (Constraints::check(val) && ...);
+            }
+            // Message of the first violated constraint.
+            template <class T>
+            static std::string error([[maybe_unused]] const T& val, [[maybe_unused]] std::string_view id, [[maybe_unused]] std::string_view raw) {
+                std::string mes;
+                ((mes.empty() && !Constraints::check(val) ? (void)(mes = Constraints::error(id, raw)) : (void)0), ...);
+                return mes;
+            }
+            static std::string describe() {
+                return (std::string() + ... + Constraints::describe());
+            }
+        };
+
+        constexpr uint32_t fixed_hash(std::string_view key, uint32_t seed) {
+            uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+            for (char c : key) {
+                h ^= (unsigned char)c;
+                h *= 16777619u;
+            }
+            h ^= h >> 15;
+            return h;
         }
 
-        void parse(int argc, char const* argv[]) try {
-            detail::parser p(argc, argv, options_);
+        // Minimal perfect hash (hash and displace) over N distinct keys.
+        // A bucket either stores a seed for its keys, or -(slot+1) when it
+        // holds a single key placed directly.
+        template <size_t N>
+        struct perfect_hash {
+            std::array<int, N> displacement {};
+            std::array<int, N> slots {};
+            bool found = true;
 
-            while(true) {
-                std::pair<std::string, std::string> op = p.next_option();
-                if(op.first == help_long) {
-                    usage(argv[0]);
-                    exit(0);
+            constexpr int find(std::string_view key, const std::array<std::string_view, N>& keys) const {
+                if constexpr (N == 0) {
+                    return -1;
+                } else {
+                    int d = displacement[fixed_hash(key, 0) % N];
+                    size_t slot = d < 0 ? size_t(-d-1) : fixed_hash(key, d) % N;
+                    int index = slots[slot];
+                    return keys[index] == key ? index : -1;
+                }
+            }
+        };
+
+        template <size_t N>
+        constexpr perfect_hash<N> make_perfect_hash(const std::array<std::string_view, N>& keys) {
+            perfect_hash<N> ph {};
+            std::array<size_t, N> bucket_of {};
+            std::array<size_t, N> bucket_size {};
+            std::array<bool, N> done {};
+            std::array<bool, N> taken {};
+            for (size_t i = 0; i < N; i++) {
+                bucket_of[i] = fixed_hash(keys[i], 0) % N;
+                bucket_size[bucket_of[i]]++;
+            }
+            for (size_t round = 0; round < N; round++) {
+                size_t b = N;
+                for (size_t j = 0; j < N; j++) {
+                    if (!done[j] && (b == N || bucket_size[j] > bucket_size[b])) {
+                        b = j;
+                    }
                 }
-                if(op.first == "") {
+                done[b] = true;
+                if (bucket_size[b] == 0) {
                     break;
                 }
-                if(op.second == "") {
-                    options_.set(op.first);
-                } else {
-                    options_.set(op.first, op.second);
+                if (bucket_size[b] == 1) {
+                    size_t slot = 0;
+                    while (taken[slot]) {
+                        slot++;
+                    }
+                    for (size_t i = 0; i < N; i++) {
+                        if (bucket_of[i] == b) {
+                            ph.slots[slot] = i;
+                        }
+                    }
+                    taken[slot] = true;
+                    ph.displacement[b] = -int(slot) - 1;
+                    continue;
                 }
-            }
-            while(true) {
-                std::string param = p.next_parameter();
-                if( param == "") {
+                for (int d = 1; ; d++) {
+                    if (d > (1 << 20)) {
+                        ph.found = false;
+                        return ph;
+                    }
+                    std::array<size_t, N> tried {};
+                    size_t count = 0;
+                    bool ok = true;
+                    for (size_t i = 0; i < N && ok; i++) {
+                        if (bucket_of[i] != b) {
+                            continue;
+                        }
+                        size_t slot = fixed_hash(keys[i], d) % N;
+                        ok = !taken[slot];
+                        for (size_t k = 0; k < count && ok; k++) {
+                            ok = tried[k] != slot;
+                        }
+                        tried[count++] = slot;
+                    }
+                    if (!ok) {
+                        continue;
+                    }
+                    count = 0;
+                    for (size_t i = 0; i < N; i++) {
+                        if (bucket_of[i] == b) {
+                            taken[tried[count]] = true;
+                            ph.slots[tried[count++]] = i;
+                        }
+                    }
+                    ph.displacement[b] = d;
                     break;
                 }
-                params_.set(param);
             }
+            return ph;
+        }
+    };  // namespace detail
+
+    template <fixed_string Name, char Short, fixed_string Message>
+    struct flag {
+        using value_type = bool;
+        using constraints = detail::constraint_list<>;
+        static constexpr detail::DeclKind kind = detail::DeclKind::FLAG;
+        static constexpr std::string_view name = Name.view();
+        static constexpr char short_name = Short;
+        static constexpr std::string_view message = Message.view();
+        static constexpr value_type default_value = false;
+    };
+
+    template <class T, fixed_string Name, char Short, fixed_string Message, T Default, class ... Constraints>
+    struct option {
+        using value_type = T;
+        using constraints = detail::constraint_list<Constraints...>;
+        static constexpr detail::DeclKind kind = detail::DeclKind::OPTION;
+        static constexpr std::string_view name = Name.view();
+        static constexpr char short_name = Short;
+        static constexpr std::string_view message = Message.view();
+        static constexpr value_type default_value = Default;
+        static_assert(constraints::check(Default), "default value violates a constraint");
+    };
+
+    template <fixed_string Name, char Short, fixed_string Message, fixed_string Default, class ... Constraints>
+    struct string_option {
+        using value_type = std::string_view;
+        using constraints = detail::constraint_list<Constraints...>;
+        static constexpr detail::DeclKind kind = detail::DeclKind::OPTION;
+        static constexpr std::string_view name = Name.view();
+        static constexpr char short_name = Short;
+        static constexpr std::string_view message = Message.view();
+        static constexpr value_type default_value = Default.view();
+        static_assert(constraints::check(Default.view()), "default value violates a constraint");
+    };
+
+    template <class T, fixed_string Name, fixed_string Message, class ... Constraints>
+    struct param {
+        using value_type = T;
+        using constraints = detail::constraint_list<Constraints...>;
+        static constexpr detail::DeclKind kind = detail::DeclKind::PARAM;
+        static constexpr std::string_view name = Name.view();
+        static constexpr char short_name = '\0';
+        static constexpr std::string_view message = Message.view();
+        static constexpr value_type default_value {};
+    };
+
+    template <class ... Decls>
+    class static_rule {
+        static constexpr size_t size_ = sizeof...(Decls);
+        template <size_t I>
+        using decl = std::tuple_element_t<I, std::tuple<Decls...>>;
+
+        static constexpr std::array<std::string_view, size_> names_ { Decls::name... };
+        static constexpr std::array<char, size_> shorts_ { Decls::short_name... };
+        static constexpr std::array<detail::DeclKind, size_> kinds_ { Decls::kind... };
 
-            for( auto& op : options_ ) {
-                if(!op.second->validate()) {
-                    std::string mes = "Option validation failed. \"--" + op.second->long_name() + "(-" + op.second->short_name() + ")\"";
-                    throw std::runtime_error(mes);
+        static constexpr bool valid_names() {
+            for (size_t i = 0; i < size_; i++) {
+                if (names_[i] == "help" || (kinds_[i] != detail::DeclKind::PARAM && shorts_[i] == 'h')) {
+                    return false;
                 }
+                for (size_t j = i+1; j < size_; j++) {
+                    if (names_[i] == names_[j]) {
+                        return false;
+                    }
+                    if (kinds_[i] != detail::DeclKind::PARAM && shorts_[i] == shorts_[j]) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+        static_assert(valid_names(), "duplicated option, or \"help\"/'h' which are reserved");
+
+        static constexpr auto long_index_ = detail::make_perfect_hash(names_);
+        static_assert(long_index_.found, "no perfect hash for the option names");
+
+        static constexpr std::array<int, 256> make_short_index() {
+            std::array<int, 256> table {};
+            for (auto& t : table) {
+                t = -1;
             }
-            for( auto& p : params_ ) {
-                if(!p.second->validate()) {
-                    std::string mes = "Argument validation failed. \"" + p.second->name() + "\"";
-                    throw std::runtime_error(mes);
+            for (size_t i = 0; i < size_; i++) {
+                if (kinds_[i] != detail::DeclKind::PARAM) {
+                    table[(unsigned char)shorts_[i]] = i;
                 }
             }
+            return table;
+        }
+        static constexpr std::array<int, 256> short_index_ = make_short_index();
 
-            return;
-        } catch (std::runtime_error& e) {
-            std::cout << "Error: " << e.what() << std::endl << std::endl;
-            usage(argv[0]);
-            exit(1);
+        static constexpr size_t param_count_ = ((Decls::kind == detail::DeclKind::PARAM ? 1 : 0) + ... + 0);
+        static constexpr std::array<int, param_count_> make_param_order() {
+            std::array<int, param_count_> order {};
+            size_t n = 0;
+            for (size_t i = 0; i < size_; i++) {
+                if (kinds_[i] == detail::DeclKind::PARAM) {
+                    order[n++] = i;
+                }
+            }
+            return order;
         }
+        static constexpr std::array<int, param_count_> param_order_ = make_param_order();
 
-        bool is_option_use(const std::string& name) const {
-            return options_.is_use(name);
+        static consteval int index_of(std::string_view name) {
+            return long_index_.find(name, names_);
         }
-        template <class T>
-        T get_option_value(const std::string& option_name) const {
-            return options_.get_value<T>(option_name);
+
+        // The message is only built when error is not null.
+        using binder = bool (*)(static_rule&, std::string_view, std::string*);
+
+        template <size_t I>
+        static bool bind(static_rule& r, std::string_view raw, std::string* error) {
+            using D = decl<I>;
+            if constexpr (D::kind == detail::DeclKind::FLAG) {
+                std::get<I>(r.values_) = true;
+            } else {
+                convert_result<typename D::value_type> res = try_convert<typename D::value_type>(raw);
+                if (!res) {
+                    if (error) {
+                        *error = id<I>() + " validation failed. " + std::string(raw) + detail::convert_error<typename D::value_type>();
+                    }
+                    return false;
+                }
+                const typename D::value_type& val = res.value;
+                if (!D::constraints::check(val)) {
+                    if (error) {
+                        *error = id<I>() + " validation failed. " + D::constraints::error(val, quoted_id<I>(), raw);
+                    }
+                    return false;
+                }
+                std::get<I>(r.values_) = val;
+            }
+            r.used_[I] = true;
+            return true;
         }
 
-        template <class T>
-        T get_param_value(const std::string& param_name) const {
-            return params_.get_value<T>(param_name);
+        template <size_t ... I>
+        static constexpr std::array<binder, size_> make_binders(std::index_sequence<I...>) {
+            return { &bind<I>... };
         }
+        static constexpr std::array<binder, size_> binders_ = make_binders(std::make_index_sequence<size_>());
 
-        void usage(std::string program) const {
-            std::string args;
-            for (const auto&p : params_) {
-                args += "<" + p.second->name() + "> ";
+        template <size_t I>
+        static std::string quoted_id() {
+            if constexpr (decl<I>::kind == detail::DeclKind::PARAM) {
+                return "\"" + std::string(names_[I]) + "\"";
+            } else {
+                return "--" + std::string(names_[I]) + "(-" + shorts_[I] + ")";
             }
-            std::string usage = "Usage: " + program + " ";
-            if( !options_.empty() ){
-                usage += "[Options ...] ";
+        }
+        template <size_t I>
+        static std::string id() {
+            if constexpr (decl<I>::kind == detail::DeclKind::PARAM) {
+                return quoted_id<I>();
+            } else {
+                return "\"" + quoted_id<I>() + "\"";
             }
-            std::cout << usage << args << std::endl;
-            if( !options_.empty() ) {
-                std::cout << std::endl << "Options:" << std::endl;
-                for(const auto& op : options_) {
-                    std::cout << "  " << "--" << op.second->long_name();
-                    int padding = options_.get_max_length() - op.second->long_name().size();
-                    if(op.second->has_value()) {
-                        std::cout << "=<value> " << std::setw(padding+2);
-                        std::cout << "[-" << op.second->short_name() <<  " <value>]" << "\t" << op.second->message() << std::endl;
-                    } else {
-                        std::cout << " " << std::setw(padding+10) << "[-" << op.second->short_name() << "]       " << "\t" << op.second->message() << std::endl;
-                    }
-                }
+        }
+
+    public:
+        constexpr static_rule() = default;
+
+        void parse(int argc, char const* argv[]) {
+            std::string error;
+            bool help = false;
+            if (!parse(argc, argv, help, error)) {
+                std::cout << "Error: " << error << std::endl << std::endl;
+                usage(argv[0]);
+                exit(1);
+            }
+            if (help) {
+                usage(argv[0]);
+                exit(0);
             }
+        }
 
-            if( params_.size() > 0) {
+        template <fixed_string Name>
+        const auto& get_option_value() const {
+            constexpr int index = index_of(Name.view());
+            static_assert(index >= 0, "undefined option");
+            static_assert(kinds_[index] != detail::DeclKind::PARAM, "not an option");
+            return std::get<index>(values_);
+        }
+
+        template <fixed_string Name>
+        bool is_option_use() const {
+            constexpr int index = index_of(Name.view());
+            static_assert(index >= 0, "undefined option");
+            static_assert(kinds_[index] != detail::DeclKind::PARAM, "not an option");
+            return used_[index];
+        }
+
+        template <fixed_string Name>
+        const auto& get_param_value() const {
+            constexpr int index = index_of(Name.view());
+            static_assert(index >= 0, "undefined parameter");
+            static_assert(kinds_[index] == detail::DeclKind::PARAM, "not a parameter");
+            return std::get<index>(values_);
+        }
+
+        void usage(std::string_view program) const {
+            std::cout << "Usage: " << program << " [Options ...] ";
+            for (int i : param_order_) {
+                std::cout << "<" << names_[i] << "> ";
+            }
+            std::cout << std::endl << std::endl << "Options:" << std::endl;
+            std::cout << "  --help [-h]\tdisplay the usage." << std::endl;
+            usage_options(std::make_index_sequence<size_>());
+            if (param_count_ > 0) {
                 std::cout << std::endl << "Arguments:" << std::endl;
-                for(const auto& p : params_) {
-                    std::cout << "  " << p.second->name() << ":\t" << p.second->message() << std::endl;
-                }
+                usage_params(std::make_index_sequence<size_>());
             }
         }
 
     private:
-        template <class T, class ... Args>
-        void add_parameter_impl(Args ... args) {
-            int order = params_.size()+1;
-            std::unique_ptr<detail::Parameter> p = std::make_unique<T>(order, std::forward<Args>(args)...);
-            params_.add(std::move(p));
+        // Same reporting order as rule::parse: malformed options fail at
+        // once, everything else after the whole command line was read.
+        bool parse(int argc, char const* argv[], bool& help, std::string& error) {
+            std::string deferred;
+            size_t cursor = 0;
+            bool options_ended = false;
+            for (int i = 1; i < argc; i++) {
+                if (!options_ended && std::string_view(argv[i]) == "--") {
+                    options_ended = true;
+                    continue;
+                }
+                detail::Token t = detail::classify(argv[i]);
+                if (options_ended || (t.type == detail::OptionType::SHORT && t.name.size() > 1 &&
+                        t.name[0] != 'h' && short_index_[(unsigned char)t.name[0]] < 0)) {
+                    t = detail::Token{ detail::OptionType::NOT_OP, std::string_view(), argv[i] };
+                }
+                int index = -1;
+                std::string_view raw;
+                if (t.type == detail::OptionType::NOT_OP) {
+                    if (cursor == param_count_) {
+                        if (deferred.empty()) {
+                            deferred = "Parameter invalid";
+                        }
+                        continue;
+                    }
+                    index = param_order_[cursor++];
+                    raw = t.value;
+                } else if (t.type == detail::OptionType::SHORT) {
+                    // Flags of a cluster are bound here, the last letter or
+                    // the one taking a value below.
+                    for (size_t k = 0; ; k++) {
+                        if (t.name[k] == 'h') {
+                            help = true;
+                            return true;
+                        }
+                        index = short_index_[(unsigned char)t.name[k]];
+                        if (index < 0) {
+                            error = "Option name invalid";
+                            return false;
+                        }
+                        if (kinds_[index] == detail::DeclKind::OPTION) {
+                            if (k+1 < t.name.size()) {
+                                raw = t.name.substr(k+1);
+                            } else if (i+1 >= argc) {
+                                error = "Option \"" + std::string(argv[i]) + "\" need a value.";
+                                return false;
+                            } else {
+                                raw = argv[++i];
+                            }
+                            break;
+                        }
+                        if (k+1 == t.name.size()) {
+                            break;
+                        }
+                        binders_[index](*this, raw, deferred.empty() ? &deferred : nullptr);
+                    }
+                } else {
+                    if (t.name == "help") {
+                        help = true;
+                        return true;
+                    }
+                    index = long_index_.find(t.name, names_);
+                    if (index < 0 || kinds_[index] == detail::DeclKind::PARAM) {
+                        error = "Parameter invalid";
+                        return false;
+                    }
+                    bool flag = kinds_[index] == detail::DeclKind::FLAG;
+                    if (t.type == detail::OptionType::LONG && !flag) {
+                        error = "Option \"--" + std::string(t.name) + "\" need a value.";
+                        return false;
+                    }
+                    if (t.type == detail::OptionType::LONG_WITH_VAL && flag) {
+                        error = "Option " + std::string(t.name) + " does't need a value.";
+                        return false;
+                    }
+                    raw = t.value;
+                }
+                binders_[index](*this, raw, deferred.empty() ? &deferred : nullptr);
+            }
+            if (deferred.empty() && cursor < param_count_) {
+                std::stringstream mes;
+                mes << "The " << cursor+1 << "(" << names_[param_order_[cursor]] << ")" << " argument is not specified.";
+                deferred = mes.str();
+            }
+            if (!deferred.empty()) {
+                error = std::move(deferred);
+                return false;
+            }
+            return true;
         }
-        template <class T, class ... Args>
-        void add_option_impl(Args ... args) {
-            std::unique_ptr<detail::Option> op = std::make_unique<T>(std::forward<Args>(args)...);
-            options_.add(std::move(op));
+
+        template <size_t ... I>
+        void usage_options(std::index_sequence<I...>) const {
+            ((decl<I>::kind != detail::DeclKind::PARAM ? (void)(std::cout << "  --" << names_[I]
+                    << (decl<I>::kind == detail::DeclKind::OPTION ? "=<value> [-" : " [-") << shorts_[I]
+                    << (decl<I>::kind == detail::DeclKind::OPTION ? " <value>]\t" : "]\t")
+                    << decl<I>::message << decl<I>::constraints::describe() << std::endl) : (void)0), ...);
+        }
+        template <size_t ... I>
+        void usage_params(std::index_sequence<I...>) const {
+            ((decl<I>::kind == detail::DeclKind::PARAM ? (void)(std::cout << "  " << names_[I] << ":\t"
+                    << decl<I>::message << decl<I>::constraints::describe() << std::endl) : (void)0), ...);
         }
 
-        std::string help_long;
-        char help_short;
-        detail::OptionsInfo options_;
-        detail::ParametersInfo params_;
+        std::tuple<typename Decls::value_type...> values_ { Decls::default_value... };
+        std::array<bool, size_> used_ {};
     };
-
-
+#endif
 
 };  // command_parser
+
+#endif  // COMMAND_PARSER_COMMAND_LINE_HPP
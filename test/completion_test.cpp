@@ -0,0 +1,107 @@
+#include "command_line.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace command_parser;
+
+namespace {
+
+    using words = std::vector<std::string>;
+
+    void add_schema(rule& r) {
+        r.add_option("verbose", 'v', "verbose output");
+        r.add_option("version", 'V', "print the version");
+        r.add_option<std::string>("mode", 'm', "mode", "safe", oneof<std::string>("safe", "fast", "fastest"));
+        r.add_option<int>("jobs", 'j', "jobs", 1);
+        r.add_subcommand("build", "build targets", [](rule& sub) {
+            sub.add_option<std::string>("target", 't', "target", "all", oneof<std::string>("all", "lib", "tests"));
+            sub.add_parameter("dir", "directory");
+        });
+        r.add_subcommand("bench", "run benchmarks", [](rule&) { });
+        r.add_subcommand("clean", "remove outputs", [](rule&) { });
+    }
+
+}
+
+TEST(Completion, LongNames) {
+    rule r;
+    add_schema(r);
+    EXPECT_EQ(r.completions("tool --ver"), (words{"--verbose", "--version"}));
+    EXPECT_EQ(r.completions("tool --j"), (words{"--jobs="}));
+    EXPECT_EQ(r.completions("tool -"),
+              (words{"--help", "--jobs=", "--mode=", "--verbose", "--version"}));
+    EXPECT_EQ(r.completions("tool --x"), words{});
+}
+
+TEST(Completion, Candidates) {
+    rule r;
+    add_schema(r);
+    EXPECT_EQ(r.completions("tool --mode=fa"), (words{"--mode=fast", "--mode=fastest"}));
+    EXPECT_EQ(r.completions("tool --mode="), (words{"--mode=fast", "--mode=fastest", "--mode=safe"}));
+    EXPECT_EQ(r.completions("tool -m s"), (words{"safe"}));
+    EXPECT_EQ(r.completions("tool -vm "), (words{"fast", "fastest", "safe"}));
+    // -m takes its value from the cluster, so "s" is a new word.
+    EXPECT_EQ(r.completions("tool -mfast b"), (words{"bench", "build"}));
+    EXPECT_EQ(r.completions("tool --jobs="), words{});
+}
+
+TEST(Completion, Subcommands) {
+    rule r;
+    add_schema(r);
+    EXPECT_EQ(r.completions("tool "), (words{"bench", "build", "clean"}));
+    EXPECT_EQ(r.completions("tool -v b"), (words{"bench", "build"}));
+    EXPECT_EQ(r.completions("tool -j 4 c"), (words{"clean"}));
+    EXPECT_EQ(r.completions("tool build --t"), (words{"--target="}));
+    EXPECT_EQ(r.completions("tool build --target=t"), (words{"--target=tests"}));
+    // Options of the enclosing level are offered too, once.
+    EXPECT_EQ(r.completions("tool build --"),
+              (words{"--help", "--jobs=", "--mode=", "--target=", "--verbose", "--version"}));
+    EXPECT_EQ(r.completions("tool build -m f"), (words{"fast", "fastest"}));
+    // After the subcommand, no other subcommand is selected.
+    EXPECT_EQ(r.completions("tool build b"), words{});
+}
+
+TEST(Completion, EndOfOptionsAndQuotes) {
+    rule r;
+    add_schema(r);
+    EXPECT_EQ(r.completions("tool -- --v"), words{});
+    EXPECT_EQ(r.completions("tool -- b"), (words{"bench", "build"}));
+    EXPECT_EQ(r.completions("tool 'b"), words{});
+    EXPECT_EQ(r.completions("tool \"--v\""), (words{"--verbose", "--version"}));
+}
+
+TEST(Completion, AddedAfterFirstUse) {
+    rule r;
+    add_schema(r);
+    EXPECT_EQ(r.completions("tool --ve"), (words{"--verbose", "--version"}));
+    r.add_option("verify", 'y', "verify outputs");
+    EXPECT_EQ(r.completions("tool --ve"), (words{"--verbose", "--verify", "--version"}));
+}
+
+TEST(Completion, CompleteWritesLines) {
+    rule r;
+    add_schema(r);
+    std::ostringstream out;
+    const char* argv[] = {"tool", "__complete", "tool --mode=f"};
+    EXPECT_TRUE(r.complete(3, argv, out));
+    EXPECT_EQ(out.str(), "--mode=fast\n--mode=fastest\n");
+
+    const char* normal[] = {"tool", "-v"};
+    std::ostringstream none;
+    EXPECT_FALSE(r.complete(2, normal, none));
+    EXPECT_EQ(none.str(), "");
+}
+
+TEST(Completion, Scripts) {
+    std::string bash = rule::completion_script(shell::bash, "/usr/bin/my-tool");
+    EXPECT_NE(bash.find("complete -o default -F _my_tool_complete my-tool\n"), std::string::npos);
+    EXPECT_NE(bash.find("my-tool __complete \"$line\""), std::string::npos);
+    std::string zsh = rule::completion_script(shell::zsh, "my-tool");
+    EXPECT_EQ(zsh.rfind("#compdef my-tool\n", 0), 0u);
+    std::string fish = rule::completion_script(shell::fish, "my-tool");
+    EXPECT_NE(fish.find("complete -c my-tool -a '(_my_tool_complete)'"), std::string::npos);
+}
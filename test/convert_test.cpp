@@ -0,0 +1,95 @@
+#include "command_line.hpp"
+
+#include <gtest/gtest.h>
+
+#include <limits>
+
+using namespace command_parser;
+
+TEST(TryConvert, Integers) {
+    EXPECT_EQ(try_convert<int>("42").value, 42);
+    EXPECT_EQ(try_convert<int>("+42").value, 42);
+    EXPECT_EQ(try_convert<int>("-7").value, -7);
+    EXPECT_EQ(try_convert<long long>("9223372036854775807").value, std::numeric_limits<long long>::max());
+    EXPECT_EQ(try_convert<unsigned>("4294967295").value, 4294967295u);
+
+    EXPECT_EQ(try_convert<int>("").ec, convert_errc::invalid_argument);
+    EXPECT_EQ(try_convert<int>("+").ec, convert_errc::invalid_argument);
+    EXPECT_EQ(try_convert<int>("+-1").ec, convert_errc::invalid_argument);
+    EXPECT_EQ(try_convert<int>("12a").ec, convert_errc::invalid_argument);
+    EXPECT_EQ(try_convert<int>(" 1").ec, convert_errc::invalid_argument);
+    EXPECT_EQ(try_convert<int>("99999999999").ec, convert_errc::out_of_range);
+    EXPECT_EQ(try_convert<unsigned char>("256").ec, convert_errc::out_of_range);
+}
+
+TEST(TryConvert, FloatingPoint) {
+    EXPECT_DOUBLE_EQ(try_convert<double>("0.25").value, 0.25);
+    EXPECT_DOUBLE_EQ(try_convert<double>("+1e3").value, 1000.0);
+    EXPECT_FLOAT_EQ(try_convert<float>("-2.5").value, -2.5f);
+    EXPECT_FALSE(try_convert<double>("1.5x"));
+    EXPECT_FALSE(try_convert<double>("."));
+    EXPECT_EQ(try_convert<double>("1e999").ec, convert_errc::out_of_range);
+}
+
+TEST(TryConvert, BoolAndStringView) {
+    EXPECT_TRUE(try_convert<bool>("true").value);
+    EXPECT_TRUE(try_convert<bool>("1").value);
+    EXPECT_FALSE(try_convert<bool>("false").value);
+    EXPECT_TRUE(try_convert<bool>("0"));
+    EXPECT_FALSE(try_convert<bool>("yes"));
+    EXPECT_EQ(try_convert<std::string_view>("any text").value, "any text");
+}
+
+TEST(Convert, ThrowsWithMessage) {
+    EXPECT_EQ(convert<int>("12"), 12);
+    EXPECT_EQ(convert<std::string>("text"), "text");
+    try {
+        convert<int>("abc");
+        FAIL();
+    } catch (std::runtime_error& e) {
+        EXPECT_STREQ(e.what(), "abc is not integer");
+    }
+    try {
+        convert<double>("abc");
+        FAIL();
+    } catch (std::runtime_error& e) {
+        EXPECT_STREQ(e.what(), "abc is not floating point number");
+    }
+    try {
+        convert<bool>("abc");
+        FAIL();
+    } catch (std::runtime_error& e) {
+        EXPECT_STREQ(e.what(), "abc is not boolean");
+    }
+}
+
+TEST(Classify, Patterns) {
+    using detail::OptionType;
+    struct Case {
+        const char* arg;
+        OptionType type;
+        const char* name;
+        const char* value;
+    };
+    const Case cases[] = {
+        {"--name", OptionType::LONG, "name", ""},
+        {"--dry-run=1", OptionType::LONG_WITH_VAL, "dry-run", "1"},
+        {"--a=b=c", OptionType::LONG_WITH_VAL, "a", "b=c"},
+        {"--a=", OptionType::LONG_WITH_VAL, "a", ""},
+        {"--a-b", OptionType::NOT_OP, "", "--a-b"},
+        {"--a=\n", OptionType::NOT_OP, "", "--a=\n"},
+        {"-x", OptionType::SHORT, "x", ""},
+        {"-xvf", OptionType::SHORT, "xvf", ""},
+        {"-j8", OptionType::SHORT, "j8", ""},
+        {"-", OptionType::NOT_OP, "", "-"},
+        {"-.", OptionType::NOT_OP, "", "-."},
+        {"file", OptionType::NOT_OP, "", "file"},
+        {"", OptionType::NOT_OP, "", ""},
+    };
+    for (const Case& c : cases) {
+        detail::Token t = detail::classify(c.arg);
+        EXPECT_EQ(t.type, c.type) << c.arg;
+        EXPECT_EQ(t.name, c.name) << c.arg;
+        EXPECT_EQ(t.value, c.value) << c.arg;
+    }
+}
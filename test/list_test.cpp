@@ -0,0 +1,74 @@
+#include "command_line.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace command_parser;
+
+namespace {
+
+    class ListTest : public ::testing::TestWithParam<argument_storage> {
+    protected:
+        void SetUp() override {
+            r.set_argument_storage(GetParam());
+            r.add_list_option<std::string>("include", 'I', "include path");
+            r.add_list_option<int>("level", 'l', "levels", ',', range<int>(1, 9));
+            r.add_list_option<std::string>("tags", 't', "tags", ',', oneof<std::string>("a", "b", "c"));
+            r.add_list_option<int>("empty", 'e', "empty");
+            r.reserve_option("include", 64);
+        }
+
+        rule r;
+    };
+
+}
+
+TEST_P(ListTest, CollectsEveryOccurrence) {
+    const char* argv[] = {"prog", "-I", "/usr/include", "--include=/opt/include", "-l", "1,2,3",
+                          "--level=9", "--tags=a,c", "-t", "b"};
+    parse_result res = r.parse_args(10, argv);
+    EXPECT_EQ(res.get_option_values<std::string>("include"), (std::vector<std::string>{"/usr/include", "/opt/include"}));
+    EXPECT_EQ(res.get_option_views("include").size(), 2u);
+    EXPECT_EQ(res.get_option_ref<std::vector<int>>("level"), (std::vector<int>{1, 2, 3, 9}));
+    EXPECT_EQ(res.get_option_values<std::string>("tags"), (std::vector<std::string>{"a", "c", "b"}));
+    EXPECT_TRUE(res.get_option_values<int>("empty").empty());
+    EXPECT_TRUE(res.get_option_ref<std::vector<int>>("empty").empty());
+    EXPECT_FALSE(res.is_option_use("empty"));
+    EXPECT_TRUE(res.is_option_use("level"));
+    EXPECT_THROW(res.get_option_value<int>("level"), std::logic_error);
+}
+
+TEST_P(ListTest, ValidatesEachElement) {
+    parse_error error;
+    const char* range_error[] = {"prog", "-l", "1,22,3"};
+    EXPECT_FALSE(r.try_parse(3, range_error, error));
+    EXPECT_EQ(error.code(), parse_errc::out_of_range);
+    EXPECT_EQ(error.value(), "22");
+    EXPECT_EQ(error.index(), 2);
+
+    const char* candidate_error[] = {"prog", "--tags=a,d"};
+    EXPECT_FALSE(r.try_parse(2, candidate_error, error));
+    EXPECT_EQ(error.code(), parse_errc::not_candidate);
+    EXPECT_EQ(error.value(), "d");
+
+    const char* convert_error[] = {"prog", "--level=1,x"};
+    EXPECT_FALSE(r.try_parse(2, convert_error, error));
+    EXPECT_EQ(error.code(), parse_errc::invalid_value);
+}
+
+TEST_P(ListTest, LongList) {
+    std::string arg = "--level=";
+    for (int i = 0; i < 1000; i++) {
+        arg += std::to_string(i % 9 + 1) + ",";
+    }
+    arg.pop_back();
+    r.reserve_option("level", 1000);
+    const char* argv[] = {"prog", arg.c_str()};
+    parse_result res = r.parse_args(2, argv);
+    const std::vector<int>& levels = res.get_option_ref<std::vector<int>>("level");
+    ASSERT_EQ(levels.size(), 1000u);
+    EXPECT_EQ(levels[999], 999 % 9 + 1);
+}
+
+INSTANTIATE_TEST_SUITE_P(Storage, ListTest, ::testing::Values(argument_storage::owned, argument_storage::view));
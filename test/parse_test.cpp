@@ -0,0 +1,209 @@
+#include "command_line.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory_resource>
+#include <vector>
+
+using namespace command_parser;
+
+namespace {
+
+    struct Args {
+        template <class ... A>
+        Args(A ... a) : argv{"prog", a...} { }
+
+        int argc() const { return (int)argv.size(); }
+        const char** data() { return argv.data(); }
+
+        std::vector<const char*> argv;
+    };
+
+    rule make_rule() {
+        rule r;
+        r.add_option("verbose", 'v', "verbose output");
+        r.add_option("dry-run", 'd', "do nothing");
+        r.add_option<int>("range", 'r', "range", 1, range<int>(1, 100));
+        r.add_option<std::string>("mode", 'm', "mode", "a", oneof<std::string>("a", "b"));
+        r.add_option<double>("ratio", 'x', "ratio", 0.5);
+        r.add_parameter("src", "source", 8);
+        r.add_parameter<int>("n", "number", range<int>(1, 9));
+        return r;
+    }
+
+}
+
+TEST(Parse, OptionsAndParameters) {
+    rule r = make_rule();
+    Args a("--range=50", "-m", "b", "-v", "file", "3");
+    parse_result res = r.parse_args(a.argc(), a.data());
+    EXPECT_FALSE(res.help());
+    EXPECT_TRUE(res.is_option_use("verbose"));
+    EXPECT_FALSE(res.is_option_use("dry-run"));
+    EXPECT_EQ(res.get_option_value<int>("range"), 50);
+    EXPECT_EQ(res.get_option_ref<int>("range"), 50);
+    EXPECT_EQ(res.get_option_value<std::string>("mode"), "b");
+    EXPECT_EQ(res.get_option_value<double>("ratio"), 0.5);
+    EXPECT_EQ(res.get_option_source("range"), value_source::command_line);
+    EXPECT_EQ(res.get_option_source("ratio"), value_source::default_value);
+    EXPECT_EQ(res.get_param_value<std::string>("src"), "file");
+    EXPECT_EQ(res.get_param_view("src"), "file");
+    EXPECT_EQ(res.get_param_value<int>("n"), 3);
+}
+
+TEST(Parse, RuleKeepsLastResult) {
+    rule r = make_rule();
+    Args a("-r", "7", "file", "3");
+    r.parse(a.argc(), a.data());
+    EXPECT_EQ(r.get_option_value<int>("range"), 7);
+    EXPECT_EQ(r.get_param_value<int>("n"), 3);
+}
+
+TEST(Parse, Help) {
+    rule r = make_rule();
+    Args a("--range=500", "-h");
+    EXPECT_TRUE(r.parse_args(a.argc(), a.data()).help());
+
+    parse_error error;
+    Args b("file", "3", "--help");
+    std::optional<parse_result> res = r.try_parse(b.argc(), b.data(), error);
+    ASSERT_TRUE(res);
+    EXPECT_TRUE(res->help());
+    EXPECT_FALSE(error);
+}
+
+TEST(Parse, TypeMismatchIsLogicError) {
+    rule r = make_rule();
+    Args a("file", "3");
+    parse_result res = r.parse_args(a.argc(), a.data());
+    EXPECT_THROW(res.get_option_ref<long>("range"), std::logic_error);
+    EXPECT_THROW(r.add_option("verbose", 'q', "again"), std::logic_error);
+    EXPECT_THROW(r.add_option("quiet", 'v', "again"), std::logic_error);
+}
+
+TEST(Parse, Errors) {
+    rule r = make_rule();
+    struct Case {
+        Args args;
+        parse_errc code;
+        int index;
+        const char* id;
+        const char* message;
+    };
+    std::vector<Case> cases = {
+        {Args("--range=500", "s", "3"), parse_errc::out_of_range, 1, "range",
+            "\"--range(-r)\" validation failed. 500 is out of range. range is [1, 100]"},
+        {Args("-r", "x", "s", "3"), parse_errc::invalid_value, 2, "range",
+            "\"--range(-r)\" validation failed. x is not integer"},
+        {Args("s", "3", "--bogus"), parse_errc::unknown_option, 3, "", "Parameter invalid"},
+        {Args("-q", "s", "3"), parse_errc::unknown_option, 1, "", "Option name invalid"},
+        {Args("s", "3", "-r"), parse_errc::missing_value, 3, "range", "Option \"-r\" need a value."},
+        {Args("s", "3", "--range"), parse_errc::missing_value, 3, "range", "Option \"--range\" need a value."},
+        {Args("--verbose=1", "s", "3"), parse_errc::unexpected_value, 1, "verbose", "Option verbose does't need a value."},
+        {Args("-m", "c", "s", "3"), parse_errc::not_candidate, 2, "mode",
+            "\"--mode(-m)\" validation failed. --mode(-m) cannot specify the \"c\""},
+        {Args("s"), parse_errc::missing_argument, -1, "n", "The 2(n) argument is not specified."},
+        {Args("s", "3", "x"), parse_errc::too_many_arguments, 3, "", "Parameter invalid"},
+        {Args("toolongvalue", "3"), parse_errc::too_long, 1, "src",
+            "\"src\" validation failed. Over-length error. Max length of \"src\" is 8."},
+        {Args("s", "0"), parse_errc::out_of_range, 2, "n",
+            "\"n\" validation failed. 0 is out of range. range is [1, 9]"},
+    };
+    for (Case& c : cases) {
+        parse_error error;
+        EXPECT_FALSE(r.try_parse(c.args.argc(), c.args.data(), error)) << c.message;
+        EXPECT_EQ(error.code(), c.code) << c.message;
+        EXPECT_EQ(error.index(), c.index) << c.message;
+        EXPECT_EQ(error.id(), c.id) << c.message;
+        EXPECT_EQ(error.message(), c.message);
+        try {
+            r.parse_args(c.args.argc(), c.args.data());
+            ADD_FAILURE() << c.message;
+        } catch (std::runtime_error& e) {
+            EXPECT_EQ(e.what(), error.message());
+        }
+    }
+}
+
+TEST(Parse, FirstErrorWins) {
+    rule r = make_rule();
+    Args a("--range=500", "-m", "c", "s", "3");
+    parse_error error;
+    EXPECT_FALSE(r.try_parse(a.argc(), a.data(), error));
+    EXPECT_EQ(error.code(), parse_errc::out_of_range);
+}
+
+TEST(Parse, ShortClusters) {
+    rule r = make_rule();
+    Args a("-vdr8", "-mb", "file", "3");
+    parse_result res = r.parse_args(a.argc(), a.data());
+    EXPECT_TRUE(res.is_option_use("verbose"));
+    EXPECT_TRUE(res.is_option_use("dry-run"));
+    EXPECT_EQ(res.get_option_value<int>("range"), 8);
+    EXPECT_EQ(res.get_option_value<std::string>("mode"), "b");
+
+    Args b("-vr", "9", "file", "3");
+    EXPECT_EQ(r.parse_args(b.argc(), b.data()).get_option_value<int>("range"), 9);
+
+    parse_error error;
+    Args c("-vq", "file", "3");
+    EXPECT_FALSE(r.try_parse(c.argc(), c.data(), error));
+    EXPECT_EQ(error.code(), parse_errc::unknown_option);
+    Args d("file", "3", "-vr");
+    EXPECT_FALSE(r.try_parse(d.argc(), d.data(), error));
+    EXPECT_EQ(error.code(), parse_errc::missing_value);
+    EXPECT_EQ(error.index(), 3);
+}
+
+TEST(Parse, EndOfOptions) {
+    rule r;
+    r.add_option("verbose", 'v', "verbose output");
+    r.add_parameter("a", "a");
+    r.add_parameter("b", "b");
+    Args a("--", "-v", "--");
+    parse_result res = r.parse_args(a.argc(), a.data());
+    EXPECT_FALSE(res.is_option_use("verbose"));
+    EXPECT_EQ(res.get_param_view("a"), "-v");
+    EXPECT_EQ(res.get_param_view("b"), "--");
+
+    Args b("-", "-12");
+    parse_result dash = r.parse_args(b.argc(), b.data());
+    EXPECT_EQ(dash.get_param_view("a"), "-");
+    EXPECT_EQ(dash.get_param_view("b"), "-12");
+}
+
+TEST(Parse, VariadicParameter) {
+    rule r;
+    r.add_parameter("out", "output");
+    r.add_variadic_parameter<int>("nums", "numbers", range<int>(0, 9));
+    Args a("o", "1", "2", "3");
+    parse_result res = r.parse_args(a.argc(), a.data());
+    EXPECT_EQ(res.get_param_values<int>("nums"), (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(res.get_param_ref<std::vector<int>>("nums").size(), 3u);
+    EXPECT_EQ(res.get_param_views("nums").size(), 3u);
+
+    Args b("o", "1", "12");
+    EXPECT_THROW(r.parse_args(b.argc(), b.data()), std::runtime_error);
+}
+
+TEST(Parse, ViewStorage) {
+    rule r = make_rule();
+    r.set_argument_storage(argument_storage::view);
+    Args a("--mode=b", "file", "3");
+    parse_result res = r.parse_args(a.argc(), a.data());
+    EXPECT_EQ(res.get_option_view("mode").data(), a.argv[1] + 7);
+    EXPECT_EQ(res.get_param_view("src").data(), a.argv[2]);
+    EXPECT_EQ(res.get_param_value<int>("n"), 3);
+}
+
+TEST(Parse, MemoryResource) {
+    std::pmr::monotonic_buffer_resource arena;
+    rule r("help", 'h', &arena);
+    r.add_option<int>("num", 'n', "num", 1);
+    r.add_parameter("src", "source");
+    Args a("-n", "4", "file");
+    std::pmr::monotonic_buffer_resource results;
+    parse_result res = r.parse_args(a.argc(), a.data(), &results);
+    EXPECT_EQ(res.get_option_value<int>("num"), 4);
+    EXPECT_EQ(res.get_param_view("src"), "file");
+}
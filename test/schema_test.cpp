@@ -0,0 +1,188 @@
+#include "command_line.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace command_parser;
+
+namespace {
+
+    void add_commands(rule& r) {
+        r.add_subcommand("db", "database tools", [](rule& db) {
+            db.add_option<int>("timeout", 'T', "timeout", 5, range<int>(1, 60));
+            db.add_subcommand("compact", "compact a table", [](rule& c) {
+                c.add_option<unsigned>("level", 'l', "level", 1u, range<unsigned>(1, 9));
+                c.add_parameter("table", "table name");
+            });
+        });
+        r.add_subcommand("bench", "run benchmarks", [](rule&) { });
+    }
+
+    void add_schema(rule& r) {
+        r.add_option("verbose", 'v', "verbose output");
+        r.add_option<int>("jobs", 'j', "jobs", 4, range<int>(1, 64));
+        r.add_option<double>("ratio", 'r', "ratio", 0.5, range<double>(0.0, 1.0));
+        r.add_option<std::string>("mode", 'm', "mode", "safe", oneof<std::string>("safe", "fast", "debug"));
+        r.add_option<std::string>("host", 'H', "host", "0.0.0.0", regex("\\d{1,3}(\\.\\d{1,3}){3}"));
+        r.add_option<long long>("limit", 'L', "limit", 1LL << 40);
+        r.add_list_option<int>("level", 'l', "levels", ',', range<int>(1, 9));
+        r.add_list_option<std::string>("tag", 't', "tags", ',', oneof<std::string>("red", "green"));
+        r.reserve_option("level", 16);
+        r.add_parameter("input", "input file", 32);
+        r.add_variadic_parameter<int>("counts", "counts", range<int>(0, 100));
+        add_commands(r);
+    }
+
+    std::string error_of(const rule& r, std::vector<const char*> argv) {
+        argv.insert(argv.begin(), "tool");
+        parse_error error;
+        if (r.try_parse((int)argv.size(), argv.data(), error)) {
+            return std::string();
+        }
+        return error.message();
+    }
+
+    class SchemaTest : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            add_schema(built);
+            image = built.save_schema();
+        }
+
+        rule built;
+        std::string image;
+    };
+
+}
+
+TEST_F(SchemaTest, SameUsage) {
+    built.set_help_width(100);
+    rule loaded{schema(image)};
+    loaded.set_help_width(100);
+    EXPECT_EQ(loaded.usage_text("tool"), built.usage_text("tool"));
+}
+
+TEST_F(SchemaTest, SameValues) {
+    rule loaded{schema(image)};
+    const char* argv[] = {"tool", "-v", "--jobs=8", "--ratio=0.25", "--level=1,2,3", "-t", "green", "in.txt", "7", "8"};
+    const parse_result& res = loaded.parse_args(10, argv);
+    EXPECT_TRUE(res.is_option_use("verbose"));
+    EXPECT_EQ(res.get_option_value<int>("jobs"), 8);
+    EXPECT_EQ(res.get_option_value<double>("ratio"), 0.25);
+    EXPECT_EQ(res.get_option_value<std::string>("mode"), "safe");
+    EXPECT_EQ(res.get_option_value<std::string>("host"), "0.0.0.0");
+    EXPECT_EQ(res.get_option_value<long long>("limit"), 1LL << 40);
+    EXPECT_EQ(res.get_option_values<int>("level"), (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(res.get_option_values<std::string>("tag"), (std::vector<std::string>{"green"}));
+    EXPECT_EQ(res.get_param_value<std::string>("input"), "in.txt");
+    EXPECT_EQ(res.get_param_values<int>("counts"), (std::vector<int>{7, 8}));
+}
+
+TEST_F(SchemaTest, SameErrors) {
+    rule loaded{schema(image)};
+    std::vector<std::vector<const char*>> cases = {
+        {"--jobs=65", "a"},
+        {"--ratio=2", "a"},
+        {"--mode=fsat", "a"},
+        {"--host=localhost", "a"},
+        {"--level=1,10", "a"},
+        {"--tag=blue", "a"},
+        {"--verbsoe", "a"},
+        {"0123456789012345678901234567890123456789"},
+        {"a", "101"},
+        {"bnech"},
+        {"db", "--timeout=61"},
+        {"db", "compact", "-l", "10", "users"},
+    };
+    for (const auto& argv : cases) {
+        std::string expected = error_of(built, argv);
+        EXPECT_FALSE(expected.empty()) << argv[0];
+        EXPECT_EQ(error_of(loaded, argv), expected);
+    }
+}
+
+TEST(Schema, Subcommands) {
+    rule built;
+    add_commands(built);
+    std::string image = built.save_schema();
+    rule loaded{schema(image)};
+    const char* argv[] = {"tool", "db", "--timeout=7", "compact", "--level=3", "users"};
+    const parse_result& res = loaded.parse_args(6, argv);
+    EXPECT_EQ(res.get_command(), "db");
+    const parse_result& db = res.get_subcommand();
+    EXPECT_EQ(db.get_option_value<int>("timeout"), 7);
+    EXPECT_EQ(db.get_command(), "compact");
+    EXPECT_EQ(db.get_subcommand().get_option_value<unsigned>("level"), 3u);
+    EXPECT_EQ(db.get_subcommand().get_param_value<std::string>("table"), "users");
+    EXPECT_EQ(loaded.completions("tool db c"), (std::vector<std::string>{"compact"}));
+}
+
+TEST_F(SchemaTest, SavedAgain) {
+    rule loaded{schema(image)};
+    EXPECT_EQ(loaded.save_schema(), image);
+}
+
+TEST_F(SchemaTest, Unaligned) {
+    std::vector<char> buffer(image.size() + 1);
+    std::copy(image.begin(), image.end(), buffer.begin() + 1);
+    rule loaded(schema(buffer.data() + 1, image.size()));
+    const char* argv[] = {"tool", "--jobs=3", "a", "1"};
+    EXPECT_EQ(loaded.parse_args(4, argv).get_option_value<int>("jobs"), 3);
+}
+
+TEST_F(SchemaTest, MappedFile) {
+    std::string path = (std::filesystem::temp_directory_path() / "cmdpsr_schema_test.bin").string();
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << image;
+    }
+    schema mapped = schema::map_file(path);
+    EXPECT_EQ(mapped.bytes(), image);
+    rule loaded(mapped);
+    const char* argv[] = {"tool", "-m", "fast", "a", "1"};
+    EXPECT_EQ(loaded.parse_args(5, argv).get_option_value<std::string>("mode"), "fast");
+    std::filesystem::remove(path);
+}
+
+TEST_F(SchemaTest, Source) {
+    std::string source = built.save_schema_source("cli_schema");
+    EXPECT_EQ(source.rfind("constexpr unsigned char cli_schema[] = {", 0), 0u);
+    std::vector<unsigned char> bytes;
+    size_t i = source.find('{') + 1;
+    while (i < source.size() && source[i] != '}') {
+        if (std::isdigit((unsigned char)source[i])) {
+            size_t end;
+            bytes.push_back((unsigned char)std::stoi(source.substr(i), &end));
+            i += end;
+        } else {
+            i++;
+        }
+    }
+    EXPECT_EQ(std::string(bytes.begin(), bytes.end()), image);
+}
+
+TEST_F(SchemaTest, Corrupt) {
+    EXPECT_THROW(schema(std::string_view(image).substr(0, 10)), std::runtime_error);
+    EXPECT_THROW(schema(std::string_view(image).substr(0, image.size() - 1)), std::runtime_error);
+    std::string bad = image;
+    bad[7] = 9;
+    EXPECT_THROW(schema(std::string_view(bad)), std::runtime_error);
+    bad = image;
+    bad[16] = (char)0xff;
+    bad[17] = (char)0xff;
+    EXPECT_THROW(rule{schema(std::string_view(bad))}, std::runtime_error);
+}
+
+TEST(Schema, UserValidator) {
+    rule r;
+    r.add_option<std::string>("name", 'n', "name", "ab", [](const std::string& s) { return s.size() % 2 == 0; });
+    EXPECT_THROW(r.save_schema(), std::logic_error);
+    rule p;
+    p.add_parameter("name", "name", 8, [](const std::string& s) { return !s.empty(); });
+    EXPECT_THROW(p.save_schema(), std::logic_error);
+}
@@ -0,0 +1,136 @@
+#include "command_line.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+using namespace command_parser;
+
+namespace {
+
+    std::string write_file(const std::string& name, const std::string& text) {
+        std::string path = ::testing::TempDir() + name;
+        std::ofstream(path) << text;
+        return path;
+    }
+
+}
+
+#if COMMAND_PARSER_MMAP
+TEST(Source, EnvironmentAndConfigFile) {
+    std::string conf = write_file("cmdpsr_app.conf",
+        "# comment\n[general]\nnum = 7\nmode = \"b\"\n  dry-run = true\nunknown_key = x\nname = first\nname = 'second value'\n");
+    setenv("CMDPSR_MODE", "a", 1);
+    setenv("CMDPSR_VERBOSE", "1", 1);
+
+    rule r;
+    r.add_option("verbose", 'v', "flag");
+    r.add_option("dry-run", 'd', "flag");
+    r.add_option<int>("num", 'n', "n", 1, range<int>(1, 100));
+    r.add_option<std::string>("mode", 'm', "m", "a", oneof<std::string>("a", "b"));
+    r.add_option<std::string>("name", 'N', "name", "none");
+    r.add_option<int>("other", 'o', "o", 3);
+    r.set_env_prefix("CMDPSR_");
+    r.set_config_file(conf);
+
+    const char* argv[] = {"prog", "--num=9"};
+    parse_result res = r.parse_args(2, argv);
+    EXPECT_EQ(res.get_option_value<int>("num"), 9);
+    EXPECT_EQ(res.get_option_source("num"), value_source::command_line);
+    EXPECT_EQ(res.get_option_value<std::string>("mode"), "a");
+    EXPECT_EQ(res.get_option_source("mode"), value_source::environment);
+    EXPECT_TRUE(res.is_option_use("verbose"));
+    EXPECT_TRUE(res.is_option_use("dry-run"));
+    EXPECT_EQ(res.get_option_source("dry-run"), value_source::config_file);
+    EXPECT_EQ(res.get_option_value<std::string>("name"), "second value");
+    EXPECT_EQ(res.get_option_source("other"), value_source::default_value);
+
+    const char* empty[] = {"prog"};
+    EXPECT_EQ(r.parse_args(1, empty).get_option_value<int>("num"), 7);
+    setenv("CMDPSR_VERBOSE", "maybe", 1);
+    EXPECT_THROW(r.parse_args(1, empty), std::runtime_error);
+    setenv("CMDPSR_VERBOSE", "0", 1);
+    EXPECT_FALSE(r.parse_args(1, empty).is_option_use("verbose"));
+    unsetenv("CMDPSR_MODE");
+    unsetenv("CMDPSR_VERBOSE");
+
+    EXPECT_THROW(r.set_config_file(write_file("cmdpsr_bad.conf", "ok = 1\nnot a pair\n")), std::runtime_error);
+}
+#endif
+
+TEST(Source, ResponseFiles) {
+    std::string path = write_file("cmdpsr_small.rsp", "--num=5 -m\n  'quoted value'   \"dq \\\"x\\\"\" plain\\ esc\n");
+    std::string at = "@" + path;
+    for (argument_storage storage : {argument_storage::owned, argument_storage::view}) {
+        rule r;
+        r.set_response_files(true);
+        r.set_argument_storage(storage);
+        r.add_option<int>("num", 'n', "n", 1);
+        r.add_option<std::string>("mode", 'm', "m", "a");
+        r.add_variadic_parameter("files", "files");
+        const char* argv[] = {"prog", "first", at.c_str(), "last", "@"};
+        parse_result res = r.parse_args(5, argv);
+        EXPECT_EQ(res.get_option_value<int>("num"), 5);
+        EXPECT_EQ(res.get_option_view("mode"), "quoted value");
+        EXPECT_EQ(res.get_param_values<std::string>("files"),
+                  (std::vector<std::string>{"first", "dq \"x\"", "plain esc", "last", "@"}));
+
+        const char* missing[] = {"prog", "@cmdpsr_nonexistent.rsp"};
+        parse_error error;
+        EXPECT_FALSE(r.try_parse(2, missing, error));
+        EXPECT_EQ(error.code(), parse_errc::response_file);
+
+        const char* ended[] = {"prog", "--", at.c_str()};
+        EXPECT_EQ(r.parse_args(3, ended).get_param_views("files")[0], at);
+    }
+
+    rule plain;
+    plain.add_variadic_parameter("files", "files");
+    const char* argv[] = {"prog", at.c_str()};
+    EXPECT_EQ(plain.parse_args(2, argv).get_param_views("files")[0], at);
+}
+
+TEST(Source, Batch) {
+    rule r;
+    r.add_option("verbose", 'v', "flag");
+    r.add_option<int>("num", 'n', "n", 1, range<int>(1, 1000000));
+    r.add_parameter("src", "s");
+
+    std::string text = "  # comment\n\n--num=5 'a b'\n-v \"x \\\"y\\\"\"\n--num=0 s\n'unterminated\n--help\n";
+    std::vector<batch_entry> entries = r.parse_batch(text);
+    ASSERT_EQ(entries.size(), 5u);
+    EXPECT_EQ(entries[0].line, 3u);
+    ASSERT_TRUE(entries[0].result);
+    EXPECT_EQ(entries[0].result->get_param_view("src"), "a b");
+    EXPECT_EQ(entries[0].result->get_option_value<int>("num"), 5);
+    ASSERT_TRUE(entries[1].result);
+    EXPECT_EQ(entries[1].result->get_param_view("src"), "x \"y\"");
+    EXPECT_TRUE(entries[1].result->is_option_use("verbose"));
+    EXPECT_FALSE(entries[2].result);
+    EXPECT_FALSE(entries[2].error.empty());
+    EXPECT_FALSE(entries[3].result);
+    ASSERT_TRUE(entries[4].result);
+    EXPECT_TRUE(entries[4].result->help());
+
+    std::string big;
+    for (int i = 0; i < 5000; i++) {
+        big += "--num=" + std::to_string(i + 1) + " 'file " + std::to_string(i) + "'\n";
+    }
+    for (unsigned threads : {1u, 4u}) {
+        std::vector<batch_entry> b = r.parse_batch(big, threads);
+        ASSERT_EQ(b.size(), 5000u);
+        for (size_t i = 0; i < b.size(); i++) {
+            ASSERT_TRUE(b[i].result);
+            EXPECT_EQ(b[i].line, i + 1);
+            EXPECT_EQ(b[i].result->get_option_value<int>("num"), (int)i + 1);
+        }
+    }
+
+    std::istringstream in("a\nb c\n");
+    entries = r.parse_batch(in);
+    ASSERT_EQ(entries.size(), 2u);
+    EXPECT_TRUE(entries[0].result);
+    EXPECT_FALSE(entries[1].result);
+}
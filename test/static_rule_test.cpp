@@ -0,0 +1,63 @@
+#include "command_line.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace command_parser;
+
+namespace {
+
+    using tool_rule = static_rule<
+        flag<"verbose", 'v', "verbose output">,
+        option<int, "range", 'r', "Support value of range.", 1, in_range<1, 100>>,
+        option<double, "ratio", 'x', "ratio", 0.5>,
+        string_option<"pattern", 'p', "Support selectable candidates", "disable", one_of<"disable", "enable">>,
+        param<std::string_view, "src", "required parameter", max_length<8>>,
+        param<int, "n", "number", in_range<1, 9>>
+    >;
+
+    void parse(tool_rule& r, std::vector<const char*> argv) {
+        argv.insert(argv.begin(), "prog");
+        r.parse((int)argv.size(), argv.data());
+    }
+
+}
+
+TEST(StaticRule, Parse) {
+    tool_rule r;
+    parse(r, {"-v", "--range=50", "-p", "enable", "file", "3"});
+    EXPECT_TRUE(r.is_option_use<"verbose">());
+    EXPECT_EQ(r.get_option_value<"range">(), 50);
+    EXPECT_EQ(r.get_option_value<"ratio">(), 0.5);
+    EXPECT_EQ(r.get_option_value<"pattern">(), "enable");
+    EXPECT_EQ(r.get_param_value<"src">(), "file");
+    EXPECT_EQ(r.get_param_value<"n">(), 3);
+}
+
+TEST(StaticRule, ShortClustersAndEndOfOptions) {
+    tool_rule r;
+    parse(r, {"-vr7", "-x0.25", "--", "-s", "4"});
+    EXPECT_TRUE(r.is_option_use<"verbose">());
+    EXPECT_EQ(r.get_option_value<"range">(), 7);
+    EXPECT_EQ(r.get_option_value<"ratio">(), 0.25);
+    EXPECT_EQ(r.get_param_value<"src">(), "-s");
+    EXPECT_EQ(r.get_param_value<"n">(), 4);
+}
+
+TEST(StaticRuleDeathTest, InvalidArguments) {
+    const std::vector<std::vector<const char*>> cases = {
+        {"--range=500", "s", "3"},
+        {"-q", "s", "3"},
+        {"-p", "other", "s", "3"},
+        {"toolongvalue", "3"},
+        {"s"},
+        {"s", "3", "-r"},
+    };
+    for (const auto& args : cases) {
+        tool_rule r;
+        EXPECT_EXIT(parse(r, args), ::testing::ExitedWithCode(1), "") << args[0];
+    }
+    tool_rule r;
+    EXPECT_EXIT(parse(r, {"-vh"}), ::testing::ExitedWithCode(0), "");
+}
@@ -0,0 +1,128 @@
+#include "command_line.hpp"
+
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace command_parser;
+
+namespace {
+
+    struct short_name {
+        bool operator()(const std::string& param) const {
+            return param.size() < 8;
+        }
+    };
+
+    void add_schema(rule& r) {
+        r.add_option("verbose", 'v', "verbose output");
+        r.add_option<int>("jobs", 'j', "jobs", 1, range<int>(1, 64));
+        r.add_option<std::string>("user", 'u', "user", "root", short_name());
+        r.add_parameter("input", "input file");
+    }
+
+    struct collector {
+        void operator()(const parse_stats& stats) const {
+            seen->push_back(stats);
+        }
+        std::vector<parse_stats>* seen;
+    };
+
+}
+
+TEST(Stats, PhasesAndCounts) {
+    rule r;
+    add_schema(r);
+    std::vector<parse_stats> seen;
+    r.set_stats_observer(collector{&seen});
+    const char* argv[] = {"prog", "-v", "--jobs=8", "-u", "alice", "in.txt"};
+    parse_result result = r.parse_args(6, argv);
+    EXPECT_EQ(result.get_option_value<int>("jobs"), 8);
+
+    ASSERT_EQ(seen.size(), 1u);
+    const parse_stats& s = seen[0];
+    EXPECT_FALSE(s.failed);
+    EXPECT_EQ(s.tokens, 5u);
+    EXPECT_EQ(s.options, 3u);
+    EXPECT_EQ(s.arguments, 1u);
+    EXPECT_GT(s.allocations, 0u);
+    EXPECT_GE(s.allocated_bytes, s.allocations);
+    EXPECT_GT(s.total_ns, 0u);
+    EXPECT_LE(s.tokenize_ns + s.option_ns + s.positional_ns + s.validation_ns + s.conversion_ns, s.total_ns);
+
+    ASSERT_EQ(s.validators.size(), 1u);
+    EXPECT_EQ(s.validators[0].name, "user");
+    EXPECT_EQ(s.validators[0].calls, 1u);
+    EXPECT_LE(s.validators[0].ns, s.validation_ns);
+}
+
+TEST(Stats, FailedAndHelp) {
+    rule r;
+    add_schema(r);
+    std::vector<parse_stats> seen;
+    r.set_stats_observer(collector{&seen});
+    parse_error error;
+    const char* bad[] = {"prog", "--jobs=99", "in.txt"};
+    EXPECT_FALSE(r.try_parse(3, bad, error));
+    const char* help[] = {"prog", "--jobs=99", "--help"};
+    EXPECT_TRUE(r.try_parse(3, help, error));
+    ASSERT_EQ(seen.size(), 2u);
+    EXPECT_TRUE(seen[0].failed);
+    EXPECT_FALSE(seen[1].failed);
+}
+
+TEST(Stats, Sampling) {
+    rule r;
+    add_schema(r);
+    std::vector<parse_stats> seen;
+    r.set_stats_observer(collector{&seen}, 4);
+    const char* argv[] = {"prog", "in.txt"};
+    for (int i = 0; i < 10; i++) {
+        r.parse_args(2, argv);
+    }
+    EXPECT_EQ(seen.size(), 3u);
+}
+
+TEST(Stats, SampledResultOutlivesParse) {
+    rule r;
+    r.add_option<std::string>("name", 'n', "name", "x");
+    r.add_subcommand("run", "run", [](rule& sub) {
+        sub.add_list_option<int>("level", 'l', "levels", ',', range<int>(1, 9));
+        sub.add_parameter("target", "target");
+    });
+    std::vector<parse_stats> seen;
+    r.set_stats_observer(collector{&seen});
+    std::optional<parse_result> result;
+    {
+        const char* argv[] = {"prog", "-n", "a long name kept in the result", "run", "-l", "1,2,3", "all"};
+        result.emplace(r.parse_args(7, argv));
+    }
+    EXPECT_EQ(result->get_option_value<std::string>("name"), "a long name kept in the result");
+    EXPECT_EQ(result->get_subcommand().get_option_values<int>("level"), (std::vector<int>{1, 2, 3}));
+    ASSERT_EQ(seen.size(), 1u);
+    EXPECT_EQ(seen[0].options, 2u);
+    EXPECT_EQ(seen[0].arguments, 1u);
+}
+
+TEST(Stats, BatchThreads) {
+    rule r;
+    add_schema(r);
+    std::mutex mutex;
+    size_t parses = 0;
+    size_t failed = 0;
+    r.set_stats_observer([&](const parse_stats& s) {
+        std::lock_guard<std::mutex> lock(mutex);
+        parses++;
+        failed += s.failed;
+    });
+    std::string text;
+    for (int i = 0; i < 2000; i++) {
+        text += i % 10 == 0 ? "--jobs=0 in\n" : "-j 4 in\n";
+    }
+    std::vector<batch_entry> entries = r.parse_batch(text, 4);
+    EXPECT_EQ(entries.size(), 2000u);
+    EXPECT_EQ(parses, 2000u);
+    EXPECT_EQ(failed, 200u);
+}
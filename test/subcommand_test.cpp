@@ -0,0 +1,94 @@
+#include "command_line.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace command_parser;
+
+namespace {
+
+    class SubcommandTest : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            builds = 0;
+            r.add_option("verbose", 'v', "verbose output");
+            r.add_option<std::string>("config", 'c', "config", "a.conf");
+            for (int i = 0; i < 100; i++) {
+                r.add_subcommand("cmd" + std::to_string(i), "generated", [this](rule&) { builds++; });
+            }
+            r.add_subcommand("db", "database tools", [this](rule& db) {
+                builds++;
+                db.add_option<int>("timeout", 't', "timeout", 5, range<int>(1, 60));
+                db.add_subcommand("compact", "compact a table", [this](rule& c) {
+                    builds++;
+                    c.add_option<int>("level", 'l', "level", 1, range<int>(1, 9));
+                    c.add_parameter("table", "table name");
+                });
+            });
+        }
+
+        std::string error_of(std::vector<const char*> argv) {
+            argv.insert(argv.begin(), "tool");
+            parse_error error;
+            if (r.try_parse((int)argv.size(), argv.data(), error)) {
+                return std::string();
+            }
+            return error.message();
+        }
+
+        rule r;
+        std::atomic<int> builds{0};
+    };
+
+}
+
+TEST_F(SubcommandTest, BuiltWhenSelected) {
+    EXPECT_EQ(builds, 0);
+    const char* argv[] = {"tool", "-v", "db", "--timeout=7", "compact", "--level=3", "-c", "x.conf", "users"};
+    parse_result res = r.parse_args(9, argv);
+    EXPECT_EQ(builds, 2);
+    EXPECT_TRUE(res.is_option_use("verbose"));
+    EXPECT_EQ(res.get_command(), "db");
+    EXPECT_EQ(res.get_option_value<std::string>("config"), "x.conf");
+    const parse_result& db = res.get_subcommand();
+    EXPECT_EQ(db.get_option_value<int>("timeout"), 7);
+    EXPECT_EQ(db.get_command(), "compact");
+    const parse_result& compact = db.get_subcommand();
+    EXPECT_EQ(compact.get_option_value<int>("level"), 3);
+    EXPECT_EQ(compact.get_param_value<std::string>("table"), "users");
+
+    r.parse_args(9, argv);
+    EXPECT_EQ(builds, 2);
+}
+
+TEST_F(SubcommandTest, Errors) {
+    EXPECT_EQ(error_of({"nope"}), "Unknown command \"nope\".");
+    EXPECT_EQ(error_of({}), "No command is given.");
+    EXPECT_NE(error_of({"--level=3", "db"}), "");
+    EXPECT_EQ(error_of({"db", "compact", "--level=30", "users"}),
+              "\"--level(-l)\" validation failed. 30 is out of range. range is [1, 9]");
+}
+
+TEST_F(SubcommandTest, Help) {
+    const char* argv[] = {"tool", "db", "compact", "--help"};
+    EXPECT_TRUE(r.parse_args(4, argv).help());
+}
+
+TEST_F(SubcommandTest, BuiltOnceAcrossThreads) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 100; i++) {
+                const char* argv[] = {"tool", "cmd42"};
+                EXPECT_EQ(r.parse_args(2, argv).get_command(), "cmd42");
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(builds, 1);
+}
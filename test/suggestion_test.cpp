@@ -0,0 +1,138 @@
+#include "command_line.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace command_parser;
+
+namespace {
+
+    using words = std::vector<std::string>;
+
+    size_t levenshtein(const std::string& a, const std::string& b) {
+        std::vector<std::vector<size_t>> d(a.size() + 1, std::vector<size_t>(b.size() + 1));
+        for (size_t i = 0; i <= a.size(); i++) {
+            d[i][0] = i;
+        }
+        for (size_t j = 0; j <= b.size(); j++) {
+            d[0][j] = j;
+        }
+        for (size_t i = 1; i <= a.size(); i++) {
+            for (size_t j = 1; j <= b.size(); j++) {
+                d[i][j] = std::min({d[i - 1][j] + 1, d[i][j - 1] + 1, d[i - 1][j - 1] + (a[i - 1] != b[j - 1])});
+            }
+        }
+        return d[a.size()][b.size()];
+    }
+
+    void add_schema(rule& r) {
+        r.add_option("verbose", 'v', "verbose output");
+        r.add_option("version", 'V', "print the version");
+        r.add_option<int>("jobs", 'j', "jobs", 1);
+        r.add_option<std::string>("mode", 'm', "mode", "safe", oneof<std::string>("safe", "fast", "debug"));
+        r.add_subcommand("build", "build targets", [](rule& sub) {
+            sub.add_option<std::string>("target", 't', "target", "all");
+        });
+        r.add_subcommand("bench", "run benchmarks", [](rule&) { });
+    }
+
+    parse_error error_of(const rule& r, std::vector<const char*> argv) {
+        argv.insert(argv.begin(), "prog");
+        parse_error error;
+        r.try_parse((int)argv.size(), argv.data(), error);
+        return error;
+    }
+
+}
+
+TEST(Suggestion, EditDistance) {
+    std::mt19937 g(7);
+    for (int n = 0; n < 2000; n++) {
+        std::string a, b;
+        size_t la = g() % (n < 1000 ? 20 : 90);
+        size_t lb = g() % (n < 1000 ? 20 : 90);
+        for (size_t i = 0; i < la; i++) {
+            a += (char)('a' + g() % 4);
+        }
+        for (size_t i = 0; i < lb; i++) {
+            b += (char)('a' + g() % 4);
+        }
+        size_t expected = levenshtein(a, b);
+        detail::EditDistance distance(a);
+        EXPECT_EQ(distance(b, 1000), expected) << a << " " << b;
+        // Bounded below the distance it only has to say "more".
+        if (expected > 0) {
+            EXPECT_GT(distance(b, expected - 1), expected - 1) << a << " " << b;
+        }
+    }
+}
+
+TEST(Suggestion, UnknownOption) {
+    rule r;
+    add_schema(r);
+    parse_error error = error_of(r, {"--verbse"});
+    EXPECT_EQ(error.code(), parse_errc::unknown_option);
+    EXPECT_EQ(error.suggestions(), (words{"--verbose"}));
+    EXPECT_EQ(error.message(), "Parameter invalid Did you mean \"--verbose\"?");
+
+    EXPECT_EQ(error_of(r, {"--versio=1"}).suggestions(), (words{"--version"}));
+    EXPECT_EQ(error_of(r, {"--verzion"}).suggestions(), (words{"--version"}));
+    EXPECT_EQ(error_of(r, {"--versiox"}).suggestions(), (words{"--version"}));
+    EXPECT_EQ(error_of(r, {"--bogus"}).suggestions(), words{});
+    EXPECT_EQ(error_of(r, {"--bogus"}).message(), "Parameter invalid");
+}
+
+TEST(Suggestion, SubcommandScopes) {
+    rule r;
+    add_schema(r);
+    EXPECT_EQ(error_of(r, {"build", "--targt=lib"}).suggestions(), (words{"--target"}));
+    EXPECT_EQ(error_of(r, {"build", "--verbos"}).suggestions(), (words{"--verbose"}));
+    EXPECT_EQ(error_of(r, {"--targt=lib", "build"}).suggestions(), words{});
+}
+
+TEST(Suggestion, CandidatesAndCommands) {
+    rule r;
+    add_schema(r);
+    parse_error error = error_of(r, {"--mode=safr", "build"});
+    EXPECT_EQ(error.code(), parse_errc::not_candidate);
+    EXPECT_EQ(error.suggestions(), (words{"safe"}));
+    EXPECT_NE(error.message().find(" Did you mean \"safe\"?"), std::string::npos);
+
+    error = error_of(r, {"buld"});
+    EXPECT_EQ(error.code(), parse_errc::unknown_command);
+    EXPECT_EQ(error.suggestions(), (words{"build"}));
+    EXPECT_EQ(error.message(), "Unknown command \"buld\". Did you mean \"build\"?");
+    EXPECT_EQ(error_of(r, {"bnech"}).suggestions(), words{});
+}
+
+TEST(Suggestion, ManyCandidates) {
+    rule r;
+    oneof<std::string> values;
+    for (int i = 0; i < 5000; i++) {
+        values.candidates().push_back("value-" + std::to_string(i * 7919 % 100000));
+    }
+    r.add_option<std::string>("value", 'V', "value", values.candidates()[0], values);
+    r.add_parameter("input", "input");
+    parse_error error = error_of(r, {"--value=valeu-7919", "in"});
+    EXPECT_EQ(error.code(), parse_errc::not_candidate);
+    EXPECT_EQ(error.suggestions(), (words{"value-7919"}));
+    // The first of the names at the nearest distance, in order.
+    EXPECT_EQ(error_of(r, {"--value=value-791", "in"}).suggestions(),
+              (words{"value-4791", "value-741", "value-7591"}));
+}
+
+TEST(Suggestion, Getters) {
+    rule r;
+    add_schema(r);
+    const char* argv[] = {"prog", "-v", "bench"};
+    parse_result result = r.parse_args(3, argv);
+    try {
+        result.is_option_use("verbos");
+        FAIL();
+    } catch (std::logic_error& e) {
+        EXPECT_EQ(std::string(e.what()), "Undefined parameter. Did you mean \"verbose\"?");
+    }
+}
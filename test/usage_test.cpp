@@ -0,0 +1,64 @@
+#include "command_line.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+using namespace command_parser;
+
+namespace {
+
+    rule make_rule() {
+        rule r;
+        r.add_option<std::string>("pattern", 'p', "Support selectable candidates", "disable",
+                                  oneof<std::string>("disable", "enable"));
+        r.add_option<int>("range", 'r', "Support value of range.", 1, range<int>(1, 100));
+        r.add_parameter("src", "required parameter which is described by a long message", 256);
+        r.add_subcommand("db", "database", [](rule&) {});
+        return r;
+    }
+
+}
+
+TEST(Usage, Text) {
+    rule r = make_rule();
+    r.set_help_width(1000);
+    EXPECT_EQ(r.usage_text("prog"),
+        "Usage: prog [Options ...] <command> <src> \n"
+        "\n"
+        "Options:\n"
+        "  --help            [-h]       \tdisplay the usage.\n"
+        "  --pattern=<value> [-p <value>]\tSupport selectable candidates : Available pattern {disable, enable}\n"
+        "  --range=<value>   [-r <value>]\tSupport value of range. : range is [1, 100]\n"
+        "\n"
+        "Commands:\n"
+        "  db:\tdatabase\n"
+        "\n"
+        "Arguments:\n"
+        "  src:\trequired parameter which is described by a long message\n");
+}
+
+TEST(Usage, Wraps) {
+    rule r = make_rule();
+    r.set_help_width(60);
+    std::string text = r.usage_text("prog");
+    std::istringstream lines(text);
+    for (std::string line; std::getline(lines, line); ) {
+        EXPECT_LE(line.size(), 60u) << line;
+    }
+    EXPECT_NE(text.find("\n        message\n"), std::string::npos);
+}
+
+TEST(Usage, CacheFollowsRule) {
+    rule r = make_rule();
+    r.set_help_width(1000);
+    std::string text = r.usage_text("prog");
+    EXPECT_EQ(r.usage_text("prog"), text);
+    std::ostringstream out;
+    r.usage("prog", out);
+    EXPECT_EQ(out.str(), text);
+    EXPECT_NE(r.usage_text("other").find("Usage: other "), std::string::npos);
+
+    r.add_option("extra", 'e', "extra flag");
+    EXPECT_NE(r.usage_text("prog").find("--extra"), std::string::npos);
+}
@@ -0,0 +1,125 @@
+#include "command_line.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace command_parser;
+
+namespace {
+
+    std::atomic<int> calls{0};
+
+    struct no_x {
+        bool operator()(const std::string& param) const {
+            calls++;
+            return param.find('x') == std::string::npos;
+        }
+    };
+
+    struct even {
+        bool operator()(const std::string& param) const {
+            if (convert<int>(param) % 2 != 0) {
+                throw std::runtime_error(param + " is odd");
+            }
+            return true;
+        }
+    };
+
+    std::string error_of(const rule& r, std::vector<const char*> argv) {
+        argv.insert(argv.begin(), "prog");
+        parse_error error;
+        if (r.try_parse((int)argv.size(), argv.data(), error)) {
+            return std::string();
+        }
+        return error.message();
+    }
+
+}
+
+TEST(Validator, Range) {
+    range<int> r(1, 9);
+    EXPECT_TRUE(r.contains(1));
+    EXPECT_FALSE(r.contains(10));
+    EXPECT_TRUE(r("9"));
+    EXPECT_THROW(r("10"), std::runtime_error);
+}
+
+TEST(Validator, Regex) {
+    regex ip("\\d{1,3}(\\.\\d{1,3}){3}");
+    EXPECT_TRUE(ip.matches("10.0.0.1"));
+    EXPECT_FALSE(ip.matches("10.0.0"));
+    EXPECT_EQ(ip.pattern(), "\\d{1,3}(\\.\\d{1,3}){3}");
+
+    rule r;
+    r.add_option<std::string>("ip", 'i', "ip", "0.0.0.0", ip);
+    r.add_parameter("dst", "dst", 15, regex("[a-z]+"));
+    EXPECT_EQ(error_of(r, {"--ip=1.2.3.4", "abc"}), "");
+    EXPECT_EQ(error_of(r, {"--ip=1.2.3", "abc"}),
+              "\"--ip(-i)\" validation failed. 1.2.3 does not match \\d{1,3}(\\.\\d{1,3}){3}");
+    EXPECT_EQ(error_of(r, {"ABC"}), "\"dst\" validation failed. ABC does not match [a-z]+");
+}
+
+TEST(Validator, Candidates) {
+    rule r;
+    r.add_option<std::string>("mode", 'm', "mode", "b", oneof<std::string>("c", "a", "b", "a"));
+    r.add_option<int>("level", 'l', "level", 1, oneof<int>(3, 1, 2));
+    EXPECT_EQ(error_of(r, {"-m", "c", "-l", "3"}), "");
+    EXPECT_EQ(error_of(r, {"-m", "d"}), "\"--mode(-m)\" validation failed. --mode(-m) cannot specify the \"d\"");
+    EXPECT_NE(error_of(r, {"-l", "4"}), "");
+}
+
+TEST(Validator, UserValidator) {
+    rule r;
+    r.add_option<int>("count", 'c', "count", 2, even());
+    r.add_parameter("name", "name", 16, [](const std::string& s) { return !s.empty() && s[0] != '_'; });
+    EXPECT_EQ(error_of(r, {"-c", "4", "ok"}), "");
+    EXPECT_EQ(error_of(r, {"-c", "3", "ok"}), "\"--count(-c)\" validation failed. 3 is odd");
+    EXPECT_NE(error_of(r, {"_hidden"}), "");
+}
+
+TEST(Validator, LazyValidationCachesResults) {
+    rule r;
+    r.set_validation(validation::lazy);
+    calls = 0;
+    for (int i = 0; i < 10; i++) {
+        r.add_option<std::string>("opt" + std::to_string(i), (char)('A' + i), "m", "default", no_x());
+    }
+    r.add_variadic_parameter("files", "files", 256, no_x());
+    EXPECT_EQ(calls, 10);
+
+    const char* argv[] = {"prog", "--opt3=abc", "f", "g", "f"};
+    for (int k = 0; k < 20; k++) {
+        parse_result res = r.parse_args(5, argv);
+        EXPECT_EQ(res.get_option_value<std::string>("opt3"), "abc");
+        EXPECT_EQ(res.get_option_ref<std::string>("opt7"), "default");
+    }
+    EXPECT_EQ(calls, 10 + 3);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 200; i++) {
+                std::string value = "--opt1=v" + std::to_string(i % 7);
+                const char* a[] = {"prog", value.c_str(), "f"};
+                EXPECT_EQ(r.parse_args(3, a).get_option_value<std::string>("opt1"), value.substr(7));
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    const char* bad[] = {"prog", "--opt3=xx", "f"};
+    EXPECT_THROW(r.parse_args(3, bad), std::runtime_error);
+    EXPECT_THROW(r.parse_args(3, bad), std::runtime_error);
+}
+
+TEST(Validator, InvalidDefault) {
+    rule r;
+    r.set_validation(validation::lazy);
+    EXPECT_THROW(r.add_option<int>("bad", 'z', "bad", 50, range<int>(1, 10)), std::logic_error);
+    r.add_option<int>("bad", 'z', "bad", 5, range<int>(1, 10));
+}